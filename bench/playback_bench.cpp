@@ -0,0 +1,245 @@
+// Drives PlaybackController through a long run of track transitions on a
+// SimulatedBackend and checks the sequencing rules on the way:
+//
+//   playback_bench [--tracks N] [--transitions N]
+//
+//  - repeat off plays every track once in order, then finishes
+//  - repeat all wraps around to the first track
+//  - shuffle with repeat all plays a permutation, then the same one again
+//  - repeat one plays the same track over and over
+//  - next / previous during a track count it as skipped, an end does not
+//  - a playlist built from picked rows plays them and can lose one
+//
+// Reports transitions per second of wall-clock time and the start latency
+// in virtual time. Exits 1 when a rule is broken.
+
+#include "PlaybackController.h"
+#include "SimulatedBackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Run {
+    std::vector<size_t> started;
+    bool finished = false;
+};
+
+std::unique_ptr<PlaylistImpl> makePlaylist(SimulatedBackend& backend, size_t count)
+{
+    auto playlist = std::make_unique<PlaylistImpl>();
+    for (size_t i = 0; i < count; ++i) {
+        Track t;
+        t.filename = "track" + std::to_string(i) + ".mp3";
+        t.title = "Track " + std::to_string(i);
+        playlist->add(t);
+        // 1 to 10 minutes, varied so transitions do not line up
+        backend.setLength(t.filename, 60000 + int64_t(i * 7919 % 540000));
+    }
+    return playlist;
+}
+
+// Starts the first track and lets the backend run until limit tracks have
+// started or playback finished
+Run play(PlaybackController& playback, SimulatedBackend& backend, size_t limit)
+{
+    Run run;
+    PlaybackController::Hooks hooks;
+    hooks.trackStarted = [&](size_t index, const Track&) { run.started.push_back(index); };
+    hooks.finished = [&]() { run.finished = true; };
+    playback.setHooks(std::move(hooks));
+
+    playback.play(size_t(playback.playlist()->currentIndex()));
+    while (run.started.size() < limit && !run.finished && backend.runNext()) {
+    }
+    // Let the last start reach Playing so it is measured
+    if (backend.state() == PlaybackBackend::State::Buffering)
+        backend.runNext();
+    playback.stop();
+    return run;
+}
+
+bool fail(const char* what)
+{
+    std::cerr << "FAIL: " << what << std::endl;
+    return false;
+}
+
+bool checkRepeatOff(size_t count)
+{
+    SimulatedBackend backend;
+    auto playlist = makePlaylist(backend, count);
+    PlaybackController playback(backend);
+    playback.setPlaylist(playlist.get());
+
+    Run run = play(playback, backend, count + 1);
+    if (!run.finished)
+        return fail("repeat off did not finish after the last track");
+    if (run.started.size() != count)
+        return fail("repeat off did not play every track exactly once");
+    for (size_t i = 0; i < count; ++i)
+        if (run.started[i] != i)
+            return fail("repeat off played out of order");
+    if (playlist->trackStore()->plays(playlist->idAt(0)) != 1)
+        return fail("a play was not counted");
+    for (size_t i = 0; i < count; ++i)
+        if (playlist->trackStore()->skips(playlist->idAt(i)) != 0)
+            return fail("a track that ended was counted as skipped");
+    return true;
+}
+
+bool checkRepeatAll(size_t count)
+{
+    SimulatedBackend backend;
+    auto playlist = makePlaylist(backend, count);
+    playlist->setRepeatMode(PlaylistImpl::RepeatMode::All);
+    PlaybackController playback(backend);
+    playback.setPlaylist(playlist.get());
+
+    Run run = play(playback, backend, 2 * count + 1);
+    if (run.finished || run.started.size() != 2 * count + 1)
+        return fail("repeat all stopped");
+    for (size_t i = 0; i < run.started.size(); ++i)
+        if (run.started[i] != i % count)
+            return fail("repeat all did not wrap around in order");
+    return true;
+}
+
+bool checkShuffle(size_t count)
+{
+    SimulatedBackend backend;
+    auto playlist = makePlaylist(backend, count);
+    playlist->setRepeatMode(PlaylistImpl::RepeatMode::All);
+    playlist->shuffle(42);
+    PlaybackController playback(backend);
+    playback.setPlaylist(playlist.get());
+
+    Run run = play(playback, backend, 2 * count);
+    if (run.started.size() != 2 * count)
+        return fail("shuffle stopped");
+    std::vector<size_t> first(run.started.begin(), run.started.begin() + count);
+    std::vector<size_t> second(run.started.begin() + count, run.started.end());
+    if (first != second)
+        return fail("shuffle with repeat all did not repeat its order");
+    std::sort(first.begin(), first.end());
+    for (size_t i = 0; i < count; ++i)
+        if (first[i] != i)
+            return fail("shuffle did not play every track once per round");
+    return true;
+}
+
+bool checkRepeatOne(size_t count)
+{
+    SimulatedBackend backend;
+    auto playlist = makePlaylist(backend, count);
+    playlist->setRepeatMode(PlaylistImpl::RepeatMode::One);
+    playlist->setCurrent(count / 2);
+    PlaybackController playback(backend);
+    playback.setPlaylist(playlist.get());
+
+    Run run = play(playback, backend, 10);
+    if (run.started.size() != 10)
+        return fail("repeat one stopped");
+    for (size_t index : run.started)
+        if (index != count / 2)
+            return fail("repeat one moved to another track");
+    return true;
+}
+
+bool checkSkips(size_t count)
+{
+    SimulatedBackend backend;
+    auto playlist = makePlaylist(backend, std::max<size_t>(count, 2));
+    PlaybackController playback(backend);
+    playback.setPlaylist(playlist.get());
+
+    playback.play(0);
+    backend.runNext(); // opened, now Playing
+    backend.advance(1000);
+    playback.next();
+    backend.runNext();
+    playback.prev();
+    const TrackStore& store = *playlist->trackStore();
+    if (store.skips(playlist->idAt(0)) != 1 || store.skips(playlist->idAt(1)) != 1)
+        return fail("next / previous during a track was not counted as a skip");
+    if (store.plays(playlist->idAt(0)) != 2)
+        return fail("going back did not count a play");
+    return true;
+}
+
+bool checkPicked(size_t count)
+{
+    SimulatedBackend backend;
+    auto source = makePlaylist(backend, std::max<size_t>(count, 3));
+    // Built from ids, as a selection or a smart playlist is
+    PlaylistImpl picked(*source, { 2, 0, 1 });
+    picked.removeAt(0);
+    if (picked.size() != 2 || picked.indexOf(source->idAt(2)) != 1 || picked.indexOf(source->idAt(0)) != -1)
+        return fail("removing a row from a playlist of picked rows");
+
+    PlaybackController playback(backend);
+    playback.setPlaylist(&picked);
+    Run run = play(playback, backend, 3);
+    if (run.started != std::vector<size_t>{ 0, 1 } || !run.finished)
+        return fail("a playlist of picked rows did not play them in order");
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t trackCount = 1000;
+    size_t transitions = 1000000;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tracks") == 0 && i + 1 < argc)
+            trackCount = size_t(std::max(1ll, std::atoll(argv[++i])));
+        else if (std::strcmp(argv[i], "--transitions") == 0 && i + 1 < argc)
+            transitions = size_t(std::max(1ll, std::atoll(argv[++i])));
+        else {
+            std::cerr << "usage: playback_bench [--tracks N] [--transitions N]" << std::endl;
+            return 2;
+        }
+    }
+
+    bool ok = checkRepeatOff(trackCount) && checkRepeatAll(trackCount)
+              && checkShuffle(trackCount) && checkRepeatOne(trackCount) && checkSkips(trackCount)
+              && checkPicked(trackCount);
+    if (!ok)
+        return 1;
+    std::cout << "sequencing rules hold for " << trackCount << " tracks" << std::endl;
+
+    SimulatedBackend backend;
+    auto playlist = makePlaylist(backend, trackCount);
+    playlist->setRepeatMode(PlaylistImpl::RepeatMode::All);
+    playlist->shuffle(7);
+    PlaybackController playback(backend);
+    playback.setPlaylist(playlist.get());
+
+    auto start = std::chrono::steady_clock::now();
+    Run run = play(playback, backend, transitions);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    PlaybackController::Stats stats = playback.stats();
+    if (run.started.size() != transitions || stats.transitions != transitions) {
+        std::cerr << "FAIL: " << stats.transitions << " of " << transitions
+                  << " transitions reached Playing" << std::endl;
+        return 1;
+    }
+
+    using Ms = std::chrono::duration<double, std::milli>;
+    std::cout << transitions << " transitions in " << seconds * 1000 << " ms ("
+              << uint64_t(transitions / seconds) << "/s), "
+              << backend.elapsed() / 3600000 << " h of virtual playback" << std::endl;
+    std::cout << "start latency: avg " << Ms(stats.totalLatency).count() / stats.transitions
+              << " ms, max " << Ms(stats.maxLatency).count() << " ms (virtual)" << std::endl;
+    return 0;
+}
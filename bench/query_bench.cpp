@@ -0,0 +1,138 @@
+// Times smart playlist queries over a synthetic library, against the same
+// filter written as a plain loop over the Track records.
+//
+//   query_bench [--tracks N] [--runs N] [query]...
+//
+// Without queries a few built-in ones run. Every query's result is checked
+// against the plain loop's.
+
+#include "Collation.h"
+#include "TrackQuery.h"
+#include "TrackStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Filter = std::function<bool(const Track&, uint32_t plays)>;
+
+struct Case {
+    std::string query;
+    Filter reference; // empty for queries given on the command line
+};
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t trackCount = 1000000;
+    int runs = 10;
+    std::vector<Case> cases;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tracks") == 0 && i + 1 < argc)
+            trackCount = size_t(std::max(1ll, std::atoll(argv[++i])));
+        else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (argv[i][0] == '-') {
+            std::cerr << "usage: query_bench [--tracks N] [--runs N] [query]..." << std::endl;
+            return 2;
+        } else
+            cases.push_back({ argv[i], {} });
+    }
+
+    if (cases.empty()) {
+        const std::string artist = collationKey("Artist 42");
+        const std::string album = collationKey("Album 42-3");
+        cases = {
+            { "length > 5:00",
+              [](const Track& t, uint32_t) { return t.lengthSeconds > 300; } },
+            { "artist = \"Artist 42\" and length > 5:00 and not album = \"Album 42-3\"",
+              [=](const Track& t, uint32_t) {
+                  return collationKey(t.artist) == artist && t.lengthSeconds > 300 && collationKey(t.album) != album;
+              } },
+            { "(year >= 1990 and year < 2000) or plays > 40",
+              [](const Track& t, uint32_t plays) { return (t.year >= 1990 && t.year < 2000) || plays > 40; } },
+            { "artist ~ \"7\" and track <= 3",
+              [](const Track& t, uint32_t) {
+                  return collationKey(t.artist).find('7') != std::string::npos && t.trackNumber <= 3;
+              } },
+        };
+    }
+
+    // Synthetic library: 5000 artists with 4 albums each
+    TrackStore store;
+    std::mt19937 random(1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < trackCount; ++i) {
+        const unsigned artist = random() % 5000;
+        const unsigned album = random() % 4;
+        Track t;
+        t.filename = "/music/" + std::to_string(i) + ".mp3";
+        t.title = "Track " + std::to_string(i);
+        t.artist = "Artist " + std::to_string(artist);
+        t.album = "Album " + std::to_string(artist) + "-" + std::to_string(album);
+        t.lengthSeconds = int(60 + random() % 540);
+        t.trackNumber = int(1 + random() % 12);
+        t.year = int(1960 + random() % 65);
+        TrackId id = store.add(t);
+        for (unsigned plays = random() % 50; plays > 0; --plays)
+            store.countPlay(id);
+    }
+    std::cout << trackCount << " tracks built in " << millisecondsSince(start) << " ms, "
+              << runs << " runs per query\n";
+
+    bool mismatch = false;
+    for (const Case& c : cases) {
+        TrackQuery query;
+        std::string error;
+        if (!TrackQuery::parse(c.query, query, error)) {
+            std::cerr << "  " << c.query << ": " << error << "\n";
+            mismatch = true;
+            continue;
+        }
+
+        std::vector<double> times;
+        Bitset result;
+        for (int run = 0; run < runs; ++run) {
+            start = std::chrono::steady_clock::now();
+            result = query.evaluate(store.columns());
+            times.push_back(millisecondsSince(start));
+        }
+        std::sort(times.begin(), times.end());
+        std::cout << "  " << c.query << "\n    " << result.count() << " matches, median "
+                  << times[times.size() / 2] << " ms, best " << times.front() << " ms";
+
+        if (c.reference) {
+            Bitset expected(store.idLimit());
+            start = std::chrono::steady_clock::now();
+            for (TrackId id = 0; id < store.idLimit(); ++id) {
+                if (c.reference(*store.get(id), store.plays(id)))
+                    expected.set(id);
+            }
+            std::cout << "; record loop " << millisecondsSince(start) << " ms";
+            for (size_t w = 0; w < expected.wordCount(); ++w) {
+                if (expected.words()[w] != result.words()[w]) {
+                    std::cout << " (results differ)";
+                    mismatch = true;
+                    break;
+                }
+            }
+        }
+        std::cout << "\n";
+    }
+    return mismatch ? 1 : 0;
+}
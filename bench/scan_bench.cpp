@@ -0,0 +1,133 @@
+// Compares the synchronous and io_uring metadata scans on a cold page cache.
+//
+//   scan_bench [--runs N] [--drop-caches] <file or directory>...
+//
+// Before every run each file's cached pages are dropped with
+// posix_fadvise(DONTNEED). That leaves inodes and dentries cached; run as
+// root with --drop-caches to also flush those through /proc/sys/vm/drop_caches.
+
+#include "LibraryScanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void collect(const fs::path& path, std::vector<std::string>& files)
+{
+    std::error_code ec;
+    if (fs::is_directory(path, ec)) {
+        for (const auto& entry : fs::recursive_directory_iterator(path, ec)) {
+            if (entry.is_regular_file(ec))
+                files.push_back(entry.path().string());
+        }
+    } else if (fs::is_regular_file(path, ec)) {
+        files.push_back(path.string());
+    }
+}
+
+void evict(const std::vector<std::string>& files, bool dropCaches)
+{
+    for (const auto& file : files) {
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    if (dropCaches) {
+        sync();
+        std::ofstream("/proc/sys/vm/drop_caches") << "3\n";
+    }
+}
+
+double timeScan(const std::vector<std::string>& files, LibraryScanner::Backend backend,
+                std::vector<TrackMetadata>& result)
+{
+    auto start = std::chrono::steady_clock::now();
+    result = LibraryScanner::scan(files, TrackMetadata::AllFields, backend);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool same(const TrackMetadata& a, const TrackMetadata& b)
+{
+    return a.title == b.title && a.artist == b.artist && a.album == b.album
+        && a.lengthSeconds == b.lengthSeconds && a.trackNumber == b.trackNumber
+        && a.trackCount == b.trackCount && a.discNumber == b.discNumber
+        && a.discCount == b.discCount && a.year == b.year && a.genre == b.genre;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int runs = 5;
+    bool dropCaches = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--drop-caches") == 0)
+            dropCaches = true;
+        else
+            collect(argv[i], files);
+    }
+    if (files.empty()) {
+        std::cerr << "usage: scan_bench [--runs N] [--drop-caches] <file or directory>..." << std::endl;
+        return 2;
+    }
+
+    const bool haveRing = LibraryScanner::ioUringAvailable();
+    std::cout << files.size() << " files, " << runs << " cold runs each"
+              << (haveRing ? "" : " (io_uring unavailable: both rows use the sync path)") << "\n";
+
+    struct Row {
+        const char* name;
+        LibraryScanner::Backend backend;
+        std::vector<double> times;
+        std::vector<TrackMetadata> result;
+    };
+    Row rows[] = {
+        { "sync", LibraryScanner::Backend::Sync, {}, {} },
+        { "io_uring", LibraryScanner::Backend::IoUring, {}, {} },
+    };
+
+    // Alternate backends so drift in the device affects both equally
+    for (int run = 0; run < runs; ++run) {
+        for (Row& row : rows) {
+            evict(files, dropCaches);
+            row.times.push_back(timeScan(files, row.backend, row.result));
+        }
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!same(rows[0].result[i], rows[1].result[i]))
+            ++mismatches;
+    }
+
+    for (Row& row : rows) {
+        std::sort(row.times.begin(), row.times.end());
+        double median = row.times[row.times.size() / 2];
+        std::cout << "  " << row.name << ": median " << median << " ms, best " << row.times.front()
+                  << " ms, " << (median > 0 ? files.size() * 1000.0 / median : 0) << " files/s\n";
+    }
+    if (mismatches) {
+        std::cout << "  " << mismatches << " files differ between backends\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "VlcBackend.h"
+
+#include <vlc/vlc.h>
+
+#include <algorithm>
+
+namespace {
+
+// Changes poll() reports besides the end of a track
+const libvlc_event_type_t kChangeEvents[] = {
+    libvlc_MediaPlayerPlaying,
+    libvlc_MediaPlayerPaused,
+    libvlc_MediaPlayerStopped,
+    libvlc_MediaPlayerLengthChanged,
+    libvlc_MediaPlayerEncounteredError,
+};
+
+}
+
+VlcBackend::VlcBackend(int argc, const char* const* argv)
+    : vlc(libvlc_new(argc, argv))
+{
+    if (!vlc)
+        return;
+    player = libvlc_media_player_new(vlc);
+    libvlc_event_manager_t* events = libvlc_media_player_event_manager(player);
+    libvlc_event_attach(events, libvlc_MediaPlayerEndReached, onEndReached, this);
+    for (libvlc_event_type_t type : kChangeEvents)
+        libvlc_event_attach(events, type, onChanged, this);
+}
+
+VlcBackend::~VlcBackend()
+{
+    if (player) {
+        libvlc_event_manager_t* events = libvlc_media_player_event_manager(player);
+        libvlc_event_detach(events, libvlc_MediaPlayerEndReached, onEndReached, this);
+        for (libvlc_event_type_t type : kChangeEvents)
+            libvlc_event_detach(events, type, onChanged, this);
+        libvlc_media_player_stop(player);
+        libvlc_media_player_release(player);
+    }
+    if (vlc)
+        libvlc_release(vlc);
+}
+
+// On a libVLC thread: just note it for poll()
+void VlcBackend::onEndReached(const libvlc_event_t*, void* data)
+{
+    VlcBackend* self = static_cast<VlcBackend*>(data);
+    self->ended = true;
+    if (self->wakeup)
+        self->wakeup();
+}
+
+// Also on a libVLC thread; poll() reads the new state itself
+void VlcBackend::onChanged(const libvlc_event_t*, void* data)
+{
+    VlcBackend* self = static_cast<VlcBackend*>(data);
+    if (self->wakeup)
+        self->wakeup();
+}
+
+void VlcBackend::load(const std::string& filename)
+{
+    ended = false;
+    libvlc_media_t* media = libvlc_media_new_path(vlc, filename.c_str());
+    libvlc_media_player_set_media(player, media);
+    libvlc_media_release(media);
+    libvlc_media_player_play(player);
+}
+
+void VlcBackend::play()
+{
+    libvlc_media_player_play(player);
+}
+
+void VlcBackend::pause()
+{
+    libvlc_media_player_set_pause(player, 1);
+}
+
+void VlcBackend::stop()
+{
+    libvlc_media_player_stop(player);
+}
+
+void VlcBackend::seek(int64_t ms)
+{
+    libvlc_media_player_set_time(player, libvlc_time_t(ms));
+}
+
+PlaybackBackend::State VlcBackend::state() const
+{
+    switch (libvlc_media_player_get_state(player)) {
+        case libvlc_Opening:
+        case libvlc_Buffering: return State::Buffering;
+        case libvlc_Playing:   return State::Playing;
+        case libvlc_Paused:    return State::Paused;
+        case libvlc_Error:     return State::Error;
+        default:               return State::Stopped;
+    }
+}
+
+int64_t VlcBackend::position() const
+{
+    return std::max<int64_t>(0, libvlc_media_player_get_time(player));
+}
+
+int64_t VlcBackend::duration() const
+{
+    return std::max<int64_t>(0, libvlc_media_player_get_length(player));
+}
+
+void VlcBackend::poll()
+{
+    if (ended.exchange(false)) {
+        if (shownState != State::Stopped) {
+            shownState = State::Stopped;
+            emitState(shownState);
+        }
+        emitEndOfTrack();
+    }
+
+    State now = state();
+    if (now != shownState) {
+        shownState = now;
+        emitState(now);
+    }
+    int64_t length = duration();
+    if (length != shownDuration) {
+        shownDuration = length;
+        emitDuration(length);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "PlaybackBackend.h"
+
+#include <atomic>
+#include <functional>
+
+struct libvlc_instance_t;
+struct libvlc_media_player_t;
+struct libvlc_event_t;
+
+// PlaybackBackend on libVLC, for the CLI and the daemon. One media player
+// lives as long as the backend; tracks are swapped in with set_media.
+//
+// libVLC reports the end of a track, state changes and the duration on
+// one of its own threads, where the player must not be touched. The
+// backend only notes an end there and calls the wakeup, if set; the owner
+// calls poll() from its loop, which delivers the end and any state or
+// duration change as events.
+class VlcBackend : public PlaybackBackend {
+public:
+    // Arguments as for libvlc_new
+    VlcBackend(int argc, const char* const* argv);
+    ~VlcBackend() override;
+
+    VlcBackend(const VlcBackend&) = delete;
+    VlcBackend& operator=(const VlcBackend&) = delete;
+
+    // False when libVLC failed to start; nothing else may be called then
+    bool ok() const { return player != nullptr; }
+
+    void load(const std::string& filename) override;
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void seek(int64_t ms) override;
+
+    State state() const override;
+    int64_t position() const override;
+    int64_t duration() const override;
+
+    // Called on a libVLC thread when poll() has something to deliver. Set
+    // it before anything plays.
+    void setWakeup(std::function<void()> wake) { wakeup = std::move(wake); }
+    void poll();
+
+private:
+    static void onEndReached(const libvlc_event_t* event, void* data);
+    static void onChanged(const libvlc_event_t* event, void* data);
+
+    libvlc_instance_t* vlc = nullptr;
+    libvlc_media_player_t* player = nullptr;
+    std::function<void()> wakeup;
+    std::atomic<bool> ended{false};
+
+    State shownState = State::Stopped;
+    int64_t shownDuration = 0;
+};
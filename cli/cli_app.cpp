@@ -7,17 +7,26 @@ int run_cli() {
     return 0;
 }
 #else
-#include <vlc/vlc.h>
 #include <ncurses.h>
 #include "PlaylistImpl.h"
-#include "Mp3Reader.h"
+#include "Library.h"
+#include "MetadataLoader.h"
+#include "PlaybackController.h"
+#include "PlayStats.h"
+#include "UpdateScheduler.h"
+#include "Prefetcher.h"
+#include "Viewport.h"
+#include "VlcBackend.h"
 #include <vector>
 #include <string>
 #include <memory>
 #include <random>
+#include <chrono>
 
 int run_cli() {
-    PlaylistImpl playlist;
+    Library library;
+    size_t active = 0;
+    PlaylistImpl* playlist = &library.playlist(active);
 
     std::vector<std::string> files = {
         "media/Adele_-_Hello.mp3",
@@ -29,29 +38,28 @@ int run_cli() {
         "media/谢霆锋-因为爱所以爱.mp3"
     };
 
-    // Load tracks with metadata
-    for (const auto& file : files) {
-        Track t;
-        t.filename = file;
-        Mp3Metadata data = Mp3Reader::read(file);
-        t.title  = data.title.empty() ? file : data.title;
-        t.artist = data.artist;
-        t.album  = data.album;
-        t.lengthSeconds = data.lengthSeconds;
-        playlist.add(t);
-    }
+    // Rows go in with their file names; the tags follow as they are read
+    MetadataLoader loader;
+    for (const std::string& file : files)
+        playlist->add(MetadataLoader::placeholder(file));
+    playlist->clearHistory();
+    loader.enqueue(*playlist, 0, playlist->size());
+
+    PlayStats playStats;
+    std::string statsError;
+    if (playStats.open(PlayStats::defaultDirectory(), statsError))
+        playStats.restore(*playlist, 0, playlist->size());
+    else
+        std::cerr << "play statistics: " << statsError << std::endl;
 
-    if (playlist.empty()) return 0;
+    if (playlist->empty()) return 0;
 
     initscr();
-    timeout(100); // Wait 100ms for input, then continue the loop anyway
     cbreak();
     noecho();
     keypad(stdscr, TRUE);
     curs_set(0);
 
-    Track currentTrack = playlist.at(0);
-
     // Initialize libVLC with increased buffers
     const char* vlc_args[] = {
         "--aout=pulse",           // Force PulseAudio
@@ -62,40 +70,112 @@ int run_cli() {
         "--no-interact" // Prevents popups from crashing your terminal
     };
 
-    libvlc_instance_t* vlc = libvlc_new(6, vlc_args);
+    VlcBackend backend(6, vlc_args);
 
     // CRITICAL: Always check for NULL to avoid Segmentation Faults
-    if (!vlc) {
+    if (!backend.ok()) {
         endwin();
         std::cerr << "Failed to initialize libVLC. Check arguments." << std::endl;
         return 1;
     }
 
-    libvlc_media_player_t* player = nullptr;
-
-    auto playTrack = [&](const Track& t) {
-        if (player) {
-            libvlc_media_player_stop(player);
-            libvlc_media_player_release(player);
-        }
+    Prefetcher prefetcher;
+    PlaybackController playback(backend, &prefetcher);
+    playback.setPlaylist(playlist);
+    playback.setPlayStats(&playStats);
+    // Set when a track starts on its own (end of the previous one)
+    bool trackChanged = false;
+    PlaybackController::Hooks hooks;
+    hooks.trackStarted = [&](size_t, const Track&) {
+        trackChanged = true;
+        loader.follow(*playlist);
+    };
+    playback.setHooks(hooks);
 
-        libvlc_media_t* media = libvlc_media_new_path(vlc, t.filename.c_str());
-        player = libvlc_media_player_new_from_media(media);
-        libvlc_media_release(media);
-        libvlc_media_player_play(player);
+    // Switches to another playlist; the playing track stays current
+    // wherever it is also listed. Smart playlists are re-run on the way.
+    auto showPlaylist = [&](size_t index) {
+        TrackId playing = playlist->idAt(size_t(playlist->currentIndex()));
+        active = index;
+        library.refresh(active);
+        playlist = &library.playlist(active);
+        playback.setPlaylist(playlist);
+        int at = playlist->indexOf(playing);
+        if (at >= 0)
+            playlist->setCurrent(size_t(at));
     };
 
-    playTrack(currentTrack);
+    playback.play(0);
+
+    bool groupMode = false;
+    int statusRow = 0;
+    std::string notice; // shown in the header until the next key
+
+    // Rows 0-2 are headers and the last line is the status; the list gets
+    // what is left and only its visible rows are drawn
+    Viewport view;
+    Viewport groupView;
+    int shownPlaying = -1;
+    auto layout = [&]() {
+        const size_t listRows = LINES > 5 ? size_t(LINES - 4) : 1;
+        view.setHeight(listRows);
+        groupView.setHeight(listRows);
+        view.setCount(playlist->size());
+        groupView.setCount(playlist->groups().albumCount());
+        statusRow = LINES - 1;
+    };
+    // Plays an album from its first track, as ordered in the playlist
+    auto playAlbum = [&](const std::string& artist, const std::string& album) {
+        std::vector<size_t> rows = playlist->albumTracks(artist, album);
+        if (!rows.empty())
+            playback.play(rows.front());
+    };
+    // Keeps the playing track on screen when it changes
+    auto followPlaying = [&]() {
+        int playing = playlist->currentIndex();
+        if (playing != shownPlaying && playing >= 0)
+            view.reveal(size_t(playing));
+        shownPlaying = playing;
+    };
 
     auto draw_ui = [&](WINDOW* win) {
         werase(win);
-        mvwprintw(win, 0, 0, "Terminal Music Player (n: next, p: prev, r: repeat, s: shuffle, q: quit)");
-        mvwprintw(win, 1, 0, "-------------------------------------------------------------------------------");
-        mvwprintw(win, 2, 0, "%3s  %-30s %-20s %-20s %6s", "#", "Title", "Artist", "Album", "Time");
+        mvwaddnstr(win, 0, 0, "Terminal Music Player (n: next, p: prev, Up/Down/PgUp/PgDn: move, Enter: play, c: go to playing, r: repeat, s: shuffle, o: sort, u/y: undo/redo, f: fork, [/]: playlists, /: smart playlist, g: groups, a: play album, q: quit)", COLS);
+        mvwprintw(win, 1, 0, "--- %s (%zu/%zu) %s", library.name(active).c_str(), active + 1, library.count(),
+                  notice.empty() ? "-----------------------------------------------------------" : notice.c_str());
 
-        for (int i = 0; i < playlist.size(); ++i) {
-            Track t = playlist.at(i);
-            if (t.filename == currentTrack.filename)
+        if (groupMode) {
+            // Artist / album summary straight from the group index, whose
+            // album list is kept sorted between changes
+            mvwprintw(win, 2, 0, " %-30s %-30s %6s %8s", "Artist", "Album", "Tracks", "Length");
+            const std::vector<GroupIndex::AlbumRow>& albums = playlist->groups().albumRows();
+            const GroupIndex::Album* playingAlbum = playlist->groups().findAlbum(playback.playing().artist,
+                                                                                 playback.playing().album);
+            for (size_t i = groupView.first(); i < std::min(groupView.end(), albums.size()); ++i) {
+                const GroupIndex::Artist& artist = *albums[i].artist;
+                const GroupIndex::Album& album = *albums[i].album;
+                bool playing = &album == playingAlbum;
+                if (playing)
+                    wattron(win, A_BOLD | A_REVERSE);
+                long long sec = album.totalSeconds;
+                mvwprintw(win, int(i - groupView.first()) + 3, 0, "%c%-30.30s %-30.30s %6zu %5lld:%02lld",
+                          i == groupView.cursor() ? '>' : ' ',
+                          artist.name.c_str(), album.name.c_str(), album.trackCount, sec / 60, sec % 60);
+                if (playing)
+                    wattroff(win, A_BOLD | A_REVERSE);
+            }
+            wrefresh(win);
+            return;
+        }
+
+        mvwprintw(win, 2, 0, " %3s  %-30s %-20s %-20s %6s", "#", "Title", "Artist", "Album", "Time");
+
+        // Only the visible rows: O(rows on screen) however long the list
+        const PlaylistImpl::Snapshot rows = playlist->snapshot();
+        const size_t playing = size_t(playlist->currentIndex());
+        for (size_t i = view.first(); i < view.end(); ++i) {
+            const Track& t = *rows[i].track;
+            if (i == playing)
                 wattron(win, A_BOLD | A_REVERSE);
 
             int min = t.lengthSeconds / 60;
@@ -103,70 +183,200 @@ int run_cli() {
             char timeBuf[16];
             snprintf(timeBuf, sizeof(timeBuf), "%d:%02d", min, sec);
 
-            mvwprintw(win, i + 3, 0, "%3d  %-30s %-20s %-20s %6s",
+            mvwprintw(win, int(i - view.first()) + 3, 0, "%c%3zu  %-30.30s %-20.20s %-20.20s %6s",
+                      i == view.cursor() ? '>' : ' ',
                       i + 1,
                       t.title.c_str(),
                       t.artist.c_str(),
                       t.album.c_str(),
                       timeBuf);
 
-            if (t.filename == currentTrack.filename)
+            if (i == playing)
                 wattroff(win, A_BOLD | A_REVERSE);
         }
-        // ADD THIS: Get current state
-        libvlc_state_t state = player ? libvlc_media_player_get_state(player) : libvlc_NothingSpecial;
+        wrefresh(win);
+    };
+
+    // Status line is repainted on its own, only when it visibly changes
+    UpdateScheduler status(UpdateScheduler::intervalFromEnvironment(std::chrono::milliseconds(100)));
+    status.setPositionResolution(1000);
+    timeout(int(status.interval().count())); // Wait one interval for input, then continue the loop anyway
+
+    auto poll_status = [&]() {
+        // Delivers end of track too, which starts the next one
+        backend.poll();
+        using State = UpdateScheduler::State;
+        switch (backend.state()) {
+            case PlaybackBackend::State::Playing:   status.setState(State::Playing);   break;
+            case PlaybackBackend::State::Paused:    status.setState(State::Paused);    break;
+            case PlaybackBackend::State::Buffering: status.setState(State::Buffering); break;
+            case PlaybackBackend::State::Error:     status.setState(State::Error);     break;
+            case PlaybackBackend::State::Stopped:   status.setState(State::Stopped);   break;
+        }
+        status.setPosition(backend.position());
+        status.setDuration(backend.duration());
+    };
+
+    auto draw_status = [&](WINDOW* win, const UpdateScheduler::Snapshot& snap) {
         const char* stateStr = "Unknown";
-        if (state == libvlc_Playing) stateStr = "PLAYING";
-        else if (state == libvlc_Buffering) stateStr = "BUFFERING...";
-        else if (state == libvlc_Error) stateStr = "ERROR";
+        switch (snap.state) {
+            case UpdateScheduler::State::Playing:   stateStr = "PLAYING";      break;
+            case UpdateScheduler::State::Paused:    stateStr = "PAUSED";       break;
+            case UpdateScheduler::State::Buffering: stateStr = "BUFFERING..."; break;
+            case UpdateScheduler::State::Error:     stateStr = "ERROR";        break;
+            case UpdateScheduler::State::Stopped:   break;
+        }
 
-        mvwprintw(win, playlist.size() + 4, 0, "Status: [%s]", stateStr);
+        int pos = int(snap.positionMs / 1000);
+        int dur = int(snap.durationMs / 1000);
+        int row = statusRow;
+        wmove(win, row, 0);
+        wclrtoeol(win);
+        mvwprintw(win, row, 0, "Status: [%s] %d:%02d / %d:%02d",
+                  stateStr, pos / 60, pos % 60, dur / 60, dur % 60);
         wrefresh(win);
     };
 
+    layout();
+    followPlaying();
     draw_ui(stdscr);
 
     bool isRunning = true;
     while (isRunning) {
         int ch = getch();
         if (ch != ERR) {
+            notice.clear();
             switch (ch) {
                 case 'n':
-                    currentTrack = playlist.next();
-                    playTrack(currentTrack);
+                    playback.next();
                     break;
                 case 'p':
-                    currentTrack = playlist.prev();
-                    playTrack(currentTrack);
+                    playback.prev();
                     break;
                 case 'r':
-                    if (playlist.getRepeatMode() == PlaylistImpl::RepeatMode::Off)
-                        playlist.setRepeatMode(PlaylistImpl::RepeatMode::All);
-                    else if (playlist.getRepeatMode() == PlaylistImpl::RepeatMode::All)
-                        playlist.setRepeatMode(PlaylistImpl::RepeatMode::One);
+                    if (playlist->getRepeatMode() == PlaylistImpl::RepeatMode::Off)
+                        playlist->setRepeatMode(PlaylistImpl::RepeatMode::All);
+                    else if (playlist->getRepeatMode() == PlaylistImpl::RepeatMode::All)
+                        playlist->setRepeatMode(PlaylistImpl::RepeatMode::One);
                     else
-                        playlist.setRepeatMode(PlaylistImpl::RepeatMode::Off);
+                        playlist->setRepeatMode(PlaylistImpl::RepeatMode::Off);
                     break;
                 case 's':
-                    if (playlist.shuffled())
-                        playlist.disableShuffle();
+                    if (playlist->shuffled())
+                        playlist->disableShuffle();
                     else
-                        playlist.shuffle(std::random_device{}());
+                        playlist->shuffle(std::random_device{}());
+                    break;
+                case 'o':
+                    playlist->sortBy(defaultSortKeys());
+                    break;
+                case 'u':
+                    playlist->undo();
+                    break;
+                case 'y':
+                    playlist->redo();
+                    break;
+                case 'f':
+                    showPlaylist(library.fork(active, library.unusedName("Playlist")));
+                    break;
+                case '[':
+                case ']':
+                    showPlaylist((active + (ch == ']' ? 1 : library.count() - 1)) % library.count());
+                    break;
+                case '/': {
+                    // Smart playlist from a query typed on the status line
+                    char text[256] = {};
+                    mvwprintw(stdscr, statusRow, 0, "Query: ");
+                    wclrtoeol(stdscr);
+                    echo();
+                    curs_set(1);
+                    timeout(-1);
+                    getnstr(text, sizeof(text) - 1);
+                    noecho();
+                    curs_set(0);
+                    timeout(int(status.interval().count()));
+
+                    TrackQuery query;
+                    std::string error;
+                    if (!text[0])
+                        break;
+                    if (!TrackQuery::parse(text, query, error)) {
+                        notice = "query: " + error;
+                        break;
+                    }
+                    showPlaylist(library.createSmart(text, query));
+                    break;
+                }
+                case 'g':
+                    groupMode = !groupMode;
+                    break;
+                case 'a':
+                    // Restart the playing track's album from its first track
+                    playAlbum(playback.playing().artist, playback.playing().album);
+                    break;
+                case KEY_UP:
+                case 'k':
+                    (groupMode ? groupView : view).moveCursor(-1);
+                    break;
+                case KEY_DOWN:
+                case 'j':
+                    (groupMode ? groupView : view).moveCursor(1);
+                    break;
+                case KEY_PPAGE:
+                    (groupMode ? groupView : view).pageUp();
+                    break;
+                case KEY_NPAGE:
+                    (groupMode ? groupView : view).pageDown();
+                    break;
+                case KEY_HOME:
+                    (groupMode ? groupView : view).setCursor(0);
+                    break;
+                case KEY_END:
+                    (groupMode ? groupView : view).setCursor(size_t(-1));
+                    break;
+                case '\n':
+                case KEY_ENTER:
+                    if (!groupMode)
+                        playback.play(view.cursor());
+                    else if (groupView.cursor() < playlist->groups().albumCount()) {
+                        const GroupIndex::AlbumRow& row = playlist->groups().albumRows()[groupView.cursor()];
+                        playAlbum(row.artist->name, row.album->name);
+                    }
+                    break;
+                case 'c':
+                    shownPlaying = -1; // reveal it again even if unchanged
+                    break;
+                case KEY_RESIZE:
+                    // ncurses has already picked up the new LINES / COLS
                     break;
                 case 'q':
                     isRunning = false;
                     break;
             }
+
+            layout();
+            followPlaying();
+            draw_ui(stdscr);
+            status.invalidate();
+            trackChanged = false;
         }
 
-        draw_ui(stdscr);
+        poll_status();
+        // No wakeup needed: getch() returns at least once an interval
+        loader.setVisible(*playlist, view.first(), view.end());
+        if (!loader.apply(library).empty())
+            trackChanged = true; // repaint with the new tags
+        if (trackChanged) {
+            trackChanged = false;
+            followPlaying();
+            draw_ui(stdscr);
+            status.invalidate();
+        }
+        UpdateScheduler::Snapshot snap;
+        if (status.poll(UpdateScheduler::Clock::now(), snap))
+            draw_status(stdscr, snap);
     }
 
-    if (player) {
-        libvlc_media_player_stop(player);
-        libvlc_media_player_release(player);
-    }
-    libvlc_release(vlc);
     endwin();
 
     return 0;
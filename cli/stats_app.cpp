@@ -0,0 +1,74 @@
+#include "Library.h"
+#include "LibraryScanner.h"
+#include "MemoryStats.h"
+#include "PlaylistSort.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isAudioFile(const fs::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return ext == ".mp3" || ext == ".flac" || ext == ".ogg" || ext == ".wav";
+}
+
+void collect(const fs::path& path, std::vector<std::string>& files)
+{
+    std::error_code ec;
+    if (fs::is_directory(path, ec)) {
+        for (const auto& entry : fs::recursive_directory_iterator(path, ec)) {
+            if (entry.is_regular_file(ec) && isAudioFile(entry.path()))
+                files.push_back(entry.path().string());
+        }
+    } else if (fs::is_regular_file(path, ec)) {
+        files.push_back(path.string());
+    }
+}
+
+}
+
+// `player --stats <file or directory>...`: loads the files the way the
+// frontends do, sorts once so the sort keys are built, and prints where
+// the memory went
+int run_stats(int argc, char* argv[])
+{
+    std::vector<std::string> files;
+    for (int i = 0; i < argc; ++i)
+        collect(argv[i], files);
+    if (files.empty()) {
+        std::cerr << "usage: player --stats <file or directory>..." << std::endl;
+        return 2;
+    }
+
+    Library library;
+    PlaylistImpl& playlist = library.playlist(0);
+    {
+        std::vector<TrackMetadata> metadata = LibraryScanner::scan(files, TrackMetadata::TrackFields);
+        for (size_t i = 0; i < files.size(); ++i) {
+            const TrackMetadata& data = metadata[i];
+            Track t;
+            t.filename = files[i];
+            t.title  = data.title.empty() ? files[i] : data.title;
+            t.artist = data.artist;
+            t.album  = data.album;
+            t.lengthSeconds = data.lengthSeconds;
+            t.trackNumber = data.trackNumber;
+            t.year = data.year;
+            playlist.add(t);
+        }
+    }
+    playlist.clearHistory();
+    playlist.sortBy(defaultSortKeys());
+
+    std::cout << MemoryStats::report(library.tracks().size());
+    return 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-size set of bits in 64-bit words, for query results over every
+// track id at once: combining two sets or counting one works a word at a
+// time. Bits past size() in the last word are always zero.
+class Bitset {
+public:
+    Bitset() = default;
+    explicit Bitset(size_t bits) { resize(bits); }
+
+    size_t size() const { return bits; }
+    // New bits are clear
+    void resize(size_t count)
+    {
+        bits = count;
+        data.resize((count + 63) / 64, 0);
+        trim();
+    }
+
+    bool test(size_t i) const { return (data[i / 64] >> (i % 64)) & 1; }
+    void set(size_t i) { data[i / 64] |= uint64_t(1) << (i % 64); }
+    void reset(size_t i) { data[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+    size_t count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : data)
+            n += std::bitset<64>(w).count();
+        return n;
+    }
+
+    // Both sets must have the same size
+    Bitset& operator&=(const Bitset& other)
+    {
+        for (size_t w = 0; w < data.size(); ++w)
+            data[w] &= other.data[w];
+        return *this;
+    }
+    Bitset& operator|=(const Bitset& other)
+    {
+        for (size_t w = 0; w < data.size(); ++w)
+            data[w] |= other.data[w];
+        return *this;
+    }
+    void flip()
+    {
+        for (uint64_t& w : data)
+            w = ~w;
+        trim();
+    }
+
+    // Calls f(index) for every set bit, in ascending order
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (size_t w = 0; w < data.size(); ++w) {
+            for (uint64_t word = data[w]; word; word &= word - 1)
+                f(w * 64 + lowestBit(word));
+        }
+    }
+
+    size_t wordCount() const { return data.size(); }
+    uint64_t* words() { return data.data(); }
+    const uint64_t* words() const { return data.data(); }
+
+private:
+    static size_t lowestBit(uint64_t word)
+    {
+#ifdef __GNUC__
+        return size_t(__builtin_ctzll(word));
+#else
+        size_t n = 0;
+        for (; !(word & 1); word >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    void trim()
+    {
+        if (bits % 64)
+            data.back() &= (uint64_t(1) << (bits % 64)) - 1;
+    }
+
+    std::vector<uint64_t> data;
+    size_t bits = 0;
+};
@@ -0,0 +1,33 @@
+#include "Collation.h"
+
+std::string collationKey(const std::string& text)
+{
+    std::string out;
+    out.reserve(text.size());
+
+    bool pendingSpace = false;
+    for (unsigned char c : text) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            pendingSpace = !out.empty();
+            continue;
+        }
+        if (pendingSpace) {
+            out += ' ';
+            pendingSpace = false;
+        }
+        out += (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : char(c);
+    }
+
+    // "The Beatles" sorts under B
+    if (out.size() > 4 && out.compare(0, 4, "the ") == 0)
+        out.erase(0, 4);
+
+    return out;
+}
+
+CollationKeys collationKeys(const std::string& title,
+                            const std::string& artist,
+                            const std::string& album)
+{
+    return { collationKey(title), collationKey(artist), collationKey(album) };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+// Normalized form of a display string used for sorting: ASCII letters are
+// case-folded, whitespace runs collapse to one space, surrounding spaces and
+// a leading "the " are dropped. Other bytes (UTF-8) are kept as-is, so the
+// result compares bytewise in code point order.
+std::string collationKey(const std::string& text);
+
+// Per-track keys, computed once and cached by PlaylistImpl
+struct CollationKeys {
+    std::string title;
+    std::string artist;
+    std::string album;
+};
+
+CollationKeys collationKeys(const std::string& title,
+                            const std::string& artist,
+                            const std::string& album);
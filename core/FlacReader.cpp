@@ -0,0 +1,64 @@
+#include "FlacReader.h"
+#include "VorbisComment.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr int kStreamInfo = 0;
+constexpr int kVorbisComment = 4;
+
+// Comment blocks bigger than this are taken to be corrupt
+constexpr uint32_t kMaxComment = 16 * 1024 * 1024;
+
+}
+
+bool FlacReader::sniff(const char* head, size_t length)
+{
+    return length >= 4 && head[0] == 'f' && head[1] == 'L' && head[2] == 'a' && head[3] == 'C';
+}
+
+TrackMetadata FlacReader::read(std::istream& file, unsigned fields)
+{
+    TrackMetadata meta;
+    char magic[4];
+    if (!file.read(magic, 4) || !sniff(magic, 4))
+        return meta;
+
+    bool needInfo = fields & TrackMetadata::Length;
+    bool needComment = fields & ~TrackMetadata::Length;
+
+    // STREAMINFO always comes first; VORBIS_COMMENT may be anywhere after it
+    unsigned char header[4];
+    while ((needInfo || needComment) && file.read(reinterpret_cast<char*>(header), 4)) {
+        const bool last = header[0] & 0x80;
+        const int type = header[0] & 0x7F;
+        const uint32_t size = (uint32_t(header[1]) << 16) | (uint32_t(header[2]) << 8) | header[3];
+
+        if (type == kStreamInfo && needInfo && size >= 18) {
+            unsigned char info[18];
+            if (!file.read(reinterpret_cast<char*>(info), 18))
+                break;
+            // 20-bit sample rate, 3 bits channels, 5 bits depth, 36-bit sample count
+            uint32_t rate = (uint32_t(info[10]) << 12) | (uint32_t(info[11]) << 4) | (info[12] >> 4);
+            uint64_t samples = (uint64_t(info[13] & 0x0F) << 32) | (uint64_t(info[14]) << 24)
+                             | (uint64_t(info[15]) << 16) | (uint64_t(info[16]) << 8) | info[17];
+            if (rate)
+                meta.lengthSeconds = int(samples / rate);
+            needInfo = false;
+            file.seekg(size - 18, std::ios::cur);
+        } else if (type == kVorbisComment && needComment && size <= kMaxComment) {
+            std::vector<char> block(size);
+            if (!file.read(block.data(), size))
+                break;
+            parseVorbisComment(block.data(), size, fields, meta);
+            needComment = false;
+        } else {
+            file.seekg(size, std::ios::cur);
+        }
+        if (last)
+            break;
+    }
+    return meta;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "TrackMetadata.h"
+
+#include <cstddef>
+#include <istream>
+
+// Native FLAC: the length from STREAMINFO and tags from VORBIS_COMMENT.
+// Other metadata blocks (pictures, seek tables, padding) are skipped over
+// without being read, and nothing past the last block needed is touched.
+class FlacReader {
+public:
+    static bool sniff(const char* head, size_t length);
+    // file is positioned at its start
+    static TrackMetadata read(std::istream& file, unsigned fields);
+};
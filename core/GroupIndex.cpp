@@ -0,0 +1,127 @@
+#include "GroupIndex.h"
+#include "Collation.h"
+#include "MemoryStats.h"
+
+#include <algorithm>
+
+void GroupIndex::add(TrackId id, const std::string& artist, const std::string& album, int seconds)
+{
+    MemoryScope scope(MemoryTag::Groups);
+    if (slots.count(id))
+        remove(id);
+
+    std::string artistKey = collationKey(artist);
+    std::string albumKey = collationKey(album);
+
+    Artist& a = artists[artistKey];
+    if (a.trackCount == 0)
+        a.name = artist;
+    a.trackCount++;
+    a.totalSeconds += seconds;
+
+    Album& g = a.albums[albumKey];
+    if (g.trackCount == 0) {
+        g.name = album;
+        albumTotal++;
+    }
+    g.trackCount++;
+    g.totalSeconds += seconds;
+    g.tracks.push_back(id);
+
+    rowCache.valid = false;
+    slots[id] = { std::move(artistKey), std::move(albumKey), g.tracks.size() - 1, seconds };
+}
+
+void GroupIndex::remove(TrackId id)
+{
+    auto it = slots.find(id);
+    if (it == slots.end())
+        return;
+
+    Slot& slot = it->second;
+    Artist& a = artists.find(slot.artistKey)->second;
+    Album& g = a.albums[slot.albumKey];
+
+    // Swap-remove, then fix the slot of the track that moved
+    TrackId moved = g.tracks.back();
+    g.tracks[slot.position] = moved;
+    g.tracks.pop_back();
+    if (moved != id)
+        slots[moved].position = slot.position;
+
+    g.trackCount--;
+    g.totalSeconds -= slot.seconds;
+    a.trackCount--;
+    a.totalSeconds -= slot.seconds;
+
+    if (g.trackCount == 0) {
+        a.albums.erase(slot.albumKey);
+        albumTotal--;
+    }
+    if (a.trackCount == 0)
+        artists.erase(slot.artistKey);
+
+    slots.erase(it);
+    rowCache.valid = false;
+}
+
+void GroupIndex::clear()
+{
+    artists.clear();
+    slots.clear();
+    albumTotal = 0;
+    rowCache.valid = false;
+}
+
+const std::vector<GroupIndex::AlbumRow>& GroupIndex::albumRows() const
+{
+    if (rowCache.valid)
+        return rowCache.rows;
+
+    MemoryScope scope(MemoryTag::Groups);
+    std::vector<std::pair<const std::string*, const Artist*>> byArtist;
+    byArtist.reserve(artists.size());
+    for (const auto& [key, artist] : artists)
+        byArtist.emplace_back(&key, &artist);
+    std::sort(byArtist.begin(), byArtist.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+
+    std::vector<AlbumRow>& rows = rowCache.rows;
+    rows.clear();
+    rows.reserve(albumTotal);
+    std::vector<std::pair<const std::string*, const Album*>> byAlbum;
+    for (const auto& [key, artist] : byArtist) {
+        byAlbum.clear();
+        for (const auto& [albumKey, album] : artist->albums)
+            byAlbum.emplace_back(&albumKey, &album);
+        std::sort(byAlbum.begin(), byAlbum.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+        for (const auto& entry : byAlbum)
+            rows.push_back({ artist, entry.second });
+    }
+    rowCache.valid = true;
+    return rows;
+}
+
+const GroupIndex::Artist* GroupIndex::findArtist(const std::string& artist) const
+{
+    auto it = artists.find(collationKey(artist));
+    return it == artists.end() ? nullptr : &it->second;
+}
+
+const GroupIndex::Album* GroupIndex::findAlbum(const std::string& artist, const std::string& album) const
+{
+    const Artist* a = findArtist(artist);
+    if (!a)
+        return nullptr;
+    auto it = a->albums.find(collationKey(album));
+    return it == a->albums.end() ? nullptr : &it->second;
+}
+
+const GroupIndex::Album* GroupIndex::albumOf(TrackId id) const
+{
+    auto it = slots.find(id);
+    if (it == slots.end())
+        return nullptr;
+    const Artist& artist = artists.find(it->second.artistKey)->second;
+    auto album = artist.albums.find(it->second.albumKey);
+    return album == artist.albums.end() ? nullptr : &album->second;
+}
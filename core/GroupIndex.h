@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Playlist.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Artist -> album -> tracks index, maintained on every add/remove in O(1)
+// amortized time so grouped views never rescan the track list. Artists
+// and albums are matched by collation key, so case and spacing variants
+// of a name land in one group.
+class GroupIndex {
+public:
+    struct Album {
+        std::string name;          // display name of the first track added
+        size_t trackCount = 0;
+        int64_t totalSeconds = 0;
+        std::vector<TrackId> tracks; // unordered
+    };
+
+    struct Artist {
+        std::string name;
+        size_t trackCount = 0;
+        int64_t totalSeconds = 0;
+        std::unordered_map<std::string, Album> albums; // by collation key
+    };
+
+    // An album with its artist, for paging through all albums
+    struct AlbumRow {
+        const Artist* artist;
+        const Album* album;
+    };
+
+    void add(TrackId id, const std::string& artist, const std::string& album, int seconds);
+    void remove(TrackId id);
+    void clear();
+
+    size_t artistCount() const { return artists.size(); }
+    size_t albumCount() const { return albumTotal; }
+    // Every album, by artist then album collation key. Built on first use
+    // after a change, so a view can page through it in O(rows shown).
+    const std::vector<AlbumRow>& albumRows() const;
+    const std::unordered_map<std::string, Artist>& all() const { return artists; }
+
+    // nullptr when there is no such group
+    const Artist* findArtist(const std::string& artist) const;
+    const Album* findAlbum(const std::string& artist, const std::string& album) const;
+    // Group of a track
+    const Album* albumOf(TrackId id) const;
+
+private:
+    // Keys, not pointers into artists, so copies (forked playlists) stay
+    // independent of the index they were copied from
+    struct Slot {
+        std::string artistKey;
+        std::string albumKey;
+        size_t position; // in Album::tracks
+        int seconds;
+    };
+
+    // Points into the index it was built for, so a copy starts out empty
+    struct RowCache {
+        std::vector<AlbumRow> rows;
+        bool valid = false;
+
+        RowCache() = default;
+        RowCache(const RowCache&) {}
+        RowCache& operator=(const RowCache&) { rows.clear(); valid = false; return *this; }
+    };
+
+    std::unordered_map<std::string, Artist> artists; // by collation key
+    std::unordered_map<TrackId, Slot> slots;
+    size_t albumTotal = 0;
+    mutable RowCache rowCache;
+};
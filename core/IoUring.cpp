@@ -0,0 +1,209 @@
+#include "IoUring.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+int sys_setup(unsigned entries, io_uring_params* params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int sys_register(int fd, unsigned opcode, void* arg, unsigned count)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// Everything the scanner submits arrived in 5.6; older kernels get the
+// synchronous path instead of failing halfway through a scan
+bool supportsOpcodes(int fd)
+{
+    const unsigned count = IORING_OP_LAST;
+    std::vector<char> storage(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op), 0);
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (sys_register(fd, IORING_REGISTER_PROBE, probe, count) < 0)
+        return false;
+
+    for (unsigned op : { unsigned(IORING_OP_STATX), unsigned(IORING_OP_OPENAT),
+                         unsigned(IORING_OP_READ), unsigned(IORING_OP_CLOSE) }) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            return false;
+    }
+    return true;
+}
+
+template <typename T>
+T* at(void* base, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}
+
+IoUring::IoUring(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = sys_setup(entries, &params);
+    if (fd < 0)
+        return;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMap == MAP_FAILED || !supportsOpcodes(fd)) {
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (cqRing != MAP_FAILED) munmap(cqRing, cqRingSize);
+        if (sqeMap != MAP_FAILED) munmap(sqeMap, sqesSize);
+        sqRing = cqRing = nullptr;
+        ::close(fd);
+        return;
+    }
+
+    sqes = static_cast<io_uring_sqe*>(sqeMap);
+    sqHead = at<unsigned>(sqRing, params.sq_off.head);
+    sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+    sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+    sqArray = at<unsigned>(sqRing, params.sq_off.array);
+    cqHead = at<unsigned>(cqRing, params.cq_off.head);
+    cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+    cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+
+    sqEntries = params.sq_entries;
+    ringFd = fd;
+}
+
+IoUring::~IoUring()
+{
+    if (ringFd < 0)
+        return;
+    munmap(sqes, sqesSize);
+    munmap(cqRing, cqRingSize);
+    munmap(sqRing, sqRingSize);
+    ::close(ringFd);
+}
+
+io_uring_sqe* IoUring::nextSqe()
+{
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail;
+    if (tail - head >= sqEntries)
+        return nullptr;
+
+    unsigned index = tail & *sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    queued++;
+    return sqe;
+}
+
+bool IoUring::prepareStatx(int dirFd, const char* path, unsigned mask, void* statxBuf, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<uintptr_t>(path);
+    sqe->len = mask;
+    sqe->off = reinterpret_cast<uintptr_t>(statxBuf);
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::prepareOpen(int dirFd, const char* path, int flags, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<uintptr_t>(path);
+    sqe->open_flags = unsigned(flags);
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::prepareRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::prepareClose(int fd, uint64_t userData)
+{
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = userData;
+    return true;
+}
+
+int IoUring::submit(unsigned minComplete)
+{
+    for (;;) {
+        int rc = sys_enter(ringFd, queued, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0);
+        if (rc >= 0) {
+            queued -= unsigned(rc) < queued ? unsigned(rc) : queued;
+            return rc;
+        }
+        if (errno != EINTR)
+            return -errno;
+    }
+}
+
+bool IoUring::pop(uint64_t& userData, int& result)
+{
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        return false;
+
+    const io_uring_cqe& cqe = cqes[head & *cqMask];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#else
+
+IoUring::IoUring(unsigned) {}
+IoUring::~IoUring() {}
+io_uring_sqe* IoUring::nextSqe() { return nullptr; }
+bool IoUring::prepareStatx(int, const char*, unsigned, void*, uint64_t) { return false; }
+bool IoUring::prepareOpen(int, const char*, int, uint64_t) { return false; }
+bool IoUring::prepareRead(int, void*, unsigned, uint64_t, uint64_t) { return false; }
+bool IoUring::prepareClose(int, uint64_t) { return false; }
+int IoUring::submit(unsigned) { return -1; }
+bool IoUring::pop(uint64_t&, int&) { return false; }
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Minimal io_uring submission / completion ring on raw syscalls, enough to
+// batch opens, reads and closes without pulling in liburing. Linux only;
+// valid() is false when the kernel (or a seccomp filter) refuses the ring
+// or lacks one of the opcodes we need.
+class IoUring {
+public:
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool valid() const { return ringFd >= 0; }
+    unsigned capacity() const { return sqEntries; }
+
+    // Queue requests; false when the submission ring is full
+    bool prepareStatx(int dirFd, const char* path, unsigned mask, void* statxBuf, uint64_t userData);
+    bool prepareOpen(int dirFd, const char* path, int flags, uint64_t userData);
+    bool prepareRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t userData);
+    bool prepareClose(int fd, uint64_t userData);
+
+    // Submits everything queued and waits for at least minComplete results
+    int submit(unsigned minComplete);
+
+    // Pops one completion; false when the completion ring is empty
+    bool pop(uint64_t& userData, int& result);
+
+private:
+    io_uring_sqe* nextSqe();
+
+    int ringFd = -1;
+    unsigned sqEntries = 0;
+    unsigned queued = 0;
+
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+};
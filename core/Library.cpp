@@ -0,0 +1,97 @@
+#include "Library.h"
+#include "MemoryStats.h"
+
+#include <algorithm>
+
+Library::Library(const std::string& firstName)
+    : store(std::make_shared<TrackStore>())
+{
+    create(firstName);
+}
+
+size_t Library::create(const std::string& name)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    lists.push_back({ name, std::make_unique<PlaylistImpl>(store), std::nullopt });
+    return lists.size() - 1;
+}
+
+size_t Library::fork(size_t from, const std::string& name)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    // Copying the source shares its tracks and sequence
+    auto copy = std::make_unique<PlaylistImpl>(*lists[from].playlist);
+    lists.push_back({ name, std::move(copy), std::nullopt });
+    return lists.size() - 1;
+}
+
+size_t Library::createFrom(size_t from, const std::vector<size_t>& indices, const std::string& name)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    auto picked = std::make_unique<PlaylistImpl>(*lists[from].playlist, indices);
+    lists.push_back({ name, std::move(picked), std::nullopt });
+    return lists.size() - 1;
+}
+
+size_t Library::createSmart(const std::string& name, const TrackQuery& query)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    lists.push_back({ name, matching(query), query });
+    return lists.size() - 1;
+}
+
+void Library::update(TrackId id, const Track& track)
+{
+    store->update(id, track);
+    for (Entry& entry : lists)
+        entry.playlist->trackUpdated(id);
+}
+
+bool Library::refresh(size_t index)
+{
+    Entry& entry = lists[index];
+    if (!entry.query)
+        return false;
+
+    MemoryScope scope(MemoryTag::Playlist);
+    const PlaylistImpl& old = *entry.playlist;
+    const TrackId playing = old.idAt(size_t(old.currentIndex()));
+    const PlaylistImpl::RepeatMode repeat = old.getRepeatMode();
+    // Let go of the old tracks first: ones only this playlist still held
+    // are gone from the library and must not match again
+    entry.playlist.reset();
+
+    entry.playlist = matching(*entry.query);
+    entry.playlist->setRepeatMode(repeat);
+    int at = entry.playlist->indexOf(playing);
+    if (at >= 0)
+        entry.playlist->setCurrent(size_t(at));
+    return true;
+}
+
+std::unique_ptr<PlaylistImpl> Library::matching(const TrackQuery& query) const
+{
+    std::vector<TrackId> ids;
+    query.evaluate(store->columns()).forEach([&](size_t id) { ids.push_back(TrackId(id)); });
+    std::sort(ids.begin(), ids.end(), [this](TrackId a, TrackId b) { return store->sequence(a) < store->sequence(b); });
+    return std::make_unique<PlaylistImpl>(store, ids);
+}
+
+bool Library::remove(size_t index)
+{
+    if (lists.size() <= 1 || index >= lists.size())
+        return false;
+    lists.erase(lists.begin() + index);
+    return true;
+}
+
+std::string Library::unusedName(const std::string& base) const
+{
+    for (size_t n = 2;; ++n) {
+        std::string candidate = base + " " + std::to_string(n);
+        bool taken = std::any_of(lists.begin(), lists.end(),
+                                 [&](const Entry& e) { return e.name == candidate; });
+        if (!taken)
+            return candidate;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "PlaylistImpl.h"
+#include "TrackQuery.h"
+#include "TrackStore.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// The user's named playlists, all drawing on one TrackStore. Starts out
+// with a single empty playlist; there is always at least one.
+class Library {
+public:
+    explicit Library(const std::string& firstName = "Playlist");
+
+    size_t count() const { return lists.size(); }
+    PlaylistImpl& playlist(size_t index) { return *lists[index].playlist; }
+    const std::string& name(size_t index) const { return lists[index].name; }
+    void rename(size_t index, const std::string& name) { lists[index].name = name; }
+
+    const TrackStore& tracks() const { return *store; }
+    // Replaces a track's metadata in the store and every playlist that
+    // has it
+    void update(TrackId id, const Track& track);
+
+    // Each returns the index of the new playlist
+    size_t create(const std::string& name);
+    // Copy-on-write copy of an existing playlist
+    size_t fork(size_t from, const std::string& name);
+    // Playlist made of some of another's tracks (e.g. the selected rows)
+    size_t createFrom(size_t from, const std::vector<size_t>& indices, const std::string& name);
+
+    // Smart playlist: every track in the library that matches query, in
+    // the order they were added
+    size_t createSmart(const std::string& name, const TrackQuery& query);
+    // nullptr for ordinary playlists
+    const TrackQuery* query(size_t index) const { return lists[index].query ? &*lists[index].query : nullptr; }
+    // Re-runs a smart playlist's query against the library as it is now.
+    // The playing track stays current if it still matches. This replaces
+    // the playlist object, so fetch playlist(index) again afterwards.
+    // Returns false for ordinary playlists.
+    bool refresh(size_t index);
+
+    // Refuses to remove the last playlist
+    bool remove(size_t index);
+
+    // "Playlist 2", "Playlist 3", ... not yet taken
+    std::string unusedName(const std::string& base) const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::unique_ptr<PlaylistImpl> playlist; // stable address for the frontends (until refresh)
+        std::optional<TrackQuery> query;        // set for smart playlists
+    };
+
+    std::unique_ptr<PlaylistImpl> matching(const TrackQuery& query) const;
+
+    std::shared_ptr<TrackStore> store;
+    std::vector<Entry> lists;
+};
@@ -0,0 +1,310 @@
+#include "LibraryScanner.h"
+#include "IoUring.h"
+#include "MemoryStats.h"
+#include "Mp3Reader.h"
+#include "TagReaders.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Files in flight at once; each needs an open, up to four reads and a close
+constexpr unsigned kWindow = 64;
+constexpr unsigned kRingEntries = 2 * kWindow;
+
+// First read covers small ID3v2 tags; larger ones (cover art) get a
+// second read once the header tells us the real size
+constexpr size_t kHeadGuess = 32 * 1024;
+
+constexpr uint64_t kCloseTag = ~0ull;
+
+}
+
+std::vector<TrackMetadata> LibraryScanner::scan(const std::vector<std::string>& files, unsigned fields,
+                                              Backend backend)
+{
+    MemoryScope scope(MemoryTag::Scan);
+    std::vector<TrackMetadata> out;
+    if (backend != Backend::Sync && scanIoUring(files, fields, out))
+        return out;
+    return scanSync(files, fields);
+}
+
+std::vector<TrackMetadata> LibraryScanner::scanSync(const std::vector<std::string>& files, unsigned fields)
+{
+    std::vector<TrackMetadata> out;
+    out.reserve(files.size());
+    for (const auto& file : files)
+        out.push_back(TagReaders::read(file, fields));
+    return out;
+}
+
+bool LibraryScanner::ioUringAvailable()
+{
+    return IoUring(2).valid();
+}
+
+#ifdef __linux__
+
+bool LibraryScanner::scanIoUring(const std::vector<std::string>& files, unsigned fields,
+                                 std::vector<TrackMetadata>& out)
+{
+    IoUring ring(kRingEntries);
+    if (!ring.valid())
+        return false;
+
+    const size_t n = files.size();
+    out.assign(n, TrackMetadata());
+
+    // Waits until every request queued since the last drain has completed;
+    // false when the ring itself fails and the scan has to be abandoned
+    auto drain = [&](unsigned count, auto&& onResult) {
+        if (ring.submit(count) < 0)
+            return false;
+        uint64_t tag;
+        int result;
+        while (count > 0) {
+            while (count > 0 && ring.pop(tag, result)) {
+                onResult(tag, result);
+                --count;
+            }
+            if (count > 0 && ring.submit(1) < 0)
+                return false;
+        }
+        return true;
+    };
+
+    // -------- stat everything, then visit in inode order --------
+    struct Entry {
+        uint64_t dev = 0;
+        uint64_t ino = 0;
+        uint64_t size = 0;
+        bool exists = false;
+    };
+    std::vector<Entry> entries(n);
+    {
+        std::vector<struct statx> stx(kRingEntries);
+        for (size_t base = 0; base < n; base += kRingEntries) {
+            unsigned count = unsigned(std::min<size_t>(kRingEntries, n - base));
+            for (unsigned i = 0; i < count; ++i)
+                ring.prepareStatx(AT_FDCWD, files[base + i].c_str(), STATX_INO | STATX_SIZE, &stx[i], i);
+            bool ok = drain(count, [&](uint64_t i, int result) {
+                if (result < 0)
+                    return;
+                Entry& e = entries[base + i];
+                e.dev = (uint64_t(stx[i].stx_dev_major) << 32) | stx[i].stx_dev_minor;
+                e.ino = stx[i].stx_ino;
+                e.size = stx[i].stx_size;
+                e.exists = true;
+            });
+            if (!ok)
+                return false;
+        }
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (entries[i].exists)
+            order.push_back(uint32_t(i));
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (entries[a].dev != entries[b].dev)
+            return entries[a].dev < entries[b].dev;
+        return entries[a].ino < entries[b].ino;
+    });
+
+    // -------- open / read / close a window at a time --------
+    struct Slot {
+        uint32_t file = 0;
+        int fd = -1;
+        std::vector<char> head;
+        size_t headRead = 0;
+        unsigned found = 0;
+        char tail[Mp3Reader::kTailSize];
+        bool haveTail = false;
+        // Without a TLEN frame: the audio's first bytes, for the length
+        bool wantsLength = false;
+        size_t audioStart = 0;
+        std::vector<char> frames;
+        size_t framesRead = 0;
+        bool failed = false;
+        bool otherFormat = false; // not MP3: left to TagReaders
+    };
+    std::vector<Slot> slots(kWindow);
+    std::vector<int> toClose;
+
+    auto abandon = [&](unsigned count) {
+        for (int fd : toClose)
+            ::close(fd);
+        for (unsigned i = 0; i < count; ++i) {
+            if (slots[i].fd >= 0)
+                ::close(slots[i].fd);
+        }
+        return false;
+    };
+
+    // Reads tagged i * 3 fill the head, i * 3 + 1 the ID3v1 tail and
+    // i * 3 + 2 the first audio frames
+    auto onRead = [&](uint64_t tag, int result) {
+        Slot& slot = slots[tag / 3];
+        if (result < 0)
+            slot.failed = true;
+        else if (tag % 3 == 1)
+            slot.haveTail = result == int(Mp3Reader::kTailSize);
+        else if (tag % 3 == 2)
+            slot.framesRead = size_t(result);
+        else
+            slot.headRead += size_t(result);
+    };
+    // Number of reads queued for whatever the tag left missing
+    auto queueRest = [&](unsigned i) {
+        Slot& slot = slots[i];
+        const uint64_t size = entries[slot.file].size;
+        unsigned queued = 0;
+        if (size >= Mp3Reader::kTailSize && Mp3Reader::wantsTail(fields, slot.found)) {
+            ring.prepareRead(slot.fd, slot.tail, Mp3Reader::kTailSize, size - Mp3Reader::kTailSize, i * 3 + 1);
+            ++queued;
+        }
+        slot.audioStart = Mp3Reader::audioStart(slot.head.data(), slot.headRead);
+        slot.wantsLength = (fields & ~slot.found & TrackMetadata::Length) && size > slot.audioStart;
+        // A small tag leaves the frames in the head already
+        const size_t probe = size_t(std::min<uint64_t>(Mp3Reader::kFrameProbeSize, size - slot.audioStart));
+        if (slot.wantsLength && slot.audioStart + probe > slot.headRead) {
+            slot.frames.resize(probe);
+            ring.prepareRead(slot.fd, slot.frames.data(), unsigned(probe), slot.audioStart, i * 3 + 2);
+            ++queued;
+        }
+        return queued;
+    };
+
+    for (size_t base = 0; base < order.size(); base += kWindow) {
+        const unsigned count = unsigned(std::min<size_t>(kWindow, order.size() - base));
+
+        // Closes from the previous window ride along with this window's opens
+        unsigned pending = 0;
+        for (int fd : toClose) {
+            ring.prepareClose(fd, kCloseTag);
+            ++pending;
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            Slot& slot = slots[i];
+            slot.file = order[base + i];
+            slot.fd = -1;
+            slot.headRead = 0;
+            slot.found = 0;
+            slot.haveTail = false;
+            slot.wantsLength = false;
+            slot.frames.clear();
+            slot.framesRead = 0;
+            slot.failed = false;
+            slot.otherFormat = false;
+            ring.prepareOpen(AT_FDCWD, files[slot.file].c_str(), O_RDONLY | O_CLOEXEC, i);
+            ++pending;
+        }
+        toClose.clear();
+        if (!drain(pending, [&](uint64_t i, int result) {
+                if (i != kCloseTag && result >= 0)
+                    slots[i].fd = result;
+            }))
+            return abandon(count);
+
+        // Head of every open file in one submission
+        pending = 0;
+        for (unsigned i = 0; i < count; ++i) {
+            Slot& slot = slots[i];
+            if (slot.fd < 0)
+                continue;
+            slot.head.resize(size_t(std::min<uint64_t>(kHeadGuess, entries[slot.file].size)));
+            if (!slot.head.empty()) {
+                ring.prepareRead(slot.fd, slot.head.data(), unsigned(slot.head.size()), 0, i * 3);
+                ++pending;
+            }
+        }
+        if (!drain(pending, onRead))
+            return abandon(count);
+
+        // Then the rest of tags bigger than the first guess when it was
+        // missing a wanted frame, or else the tail if ID3v1 could help and
+        // the first audio frames if the length is still unknown
+        pending = 0;
+        std::vector<unsigned> extended;
+        for (unsigned i = 0; i < count; ++i) {
+            Slot& slot = slots[i];
+            if (slot.fd < 0 || slot.failed)
+                continue;
+            if (&TagReaders::detect(slot.head.data(), slot.headRead) != &TagReaders::mp3) {
+                slot.otherFormat = true;
+                continue;
+            }
+            slot.found = Mp3Reader::parseHead(slot.head.data(), slot.headRead, fields, out[slot.file]);
+            size_t wanted = std::min<uint64_t>(Mp3Reader::headSize(slot.head.data(), slot.headRead),
+                                               entries[slot.file].size);
+            if ((slot.found & fields) != fields && wanted > slot.headRead) {
+                slot.head.resize(wanted);
+                ring.prepareRead(slot.fd, slot.head.data() + slot.headRead, unsigned(wanted - slot.headRead),
+                                 slot.headRead, i * 3);
+                extended.push_back(i);
+                ++pending;
+            } else {
+                pending += queueRest(i);
+            }
+        }
+        if (!drain(pending, onRead))
+            return abandon(count);
+
+        pending = 0;
+        for (unsigned i : extended) {
+            Slot& slot = slots[i];
+            if (slot.failed)
+                continue;
+            slot.found = Mp3Reader::parseHead(slot.head.data(), slot.headRead, fields, out[slot.file]);
+            pending += queueRest(i);
+        }
+        if (!drain(pending, onRead))
+            return abandon(count);
+
+        for (unsigned i = 0; i < count; ++i) {
+            Slot& slot = slots[i];
+            if (slot.fd < 0)
+                continue;
+            toClose.push_back(slot.fd);
+            if (slot.failed || slot.otherFormat) {
+                out[slot.file] = TagReaders::read(files[slot.file], fields);
+                continue;
+            }
+            if (slot.haveTail)
+                Mp3Reader::parseTail(slot.tail, fields, slot.found, out[slot.file]);
+            if (slot.wantsLength) {
+                const uint64_t audioBytes = entries[slot.file].size - slot.audioStart;
+                out[slot.file].lengthSeconds = slot.frames.empty()
+                    ? Mp3Reader::estimateLength(slot.head.data() + slot.audioStart,
+                                                std::min(slot.headRead - slot.audioStart, Mp3Reader::kFrameProbeSize),
+                                                audioBytes)
+                    : Mp3Reader::estimateLength(slot.frames.data(), slot.framesRead, audioBytes);
+            }
+        }
+    }
+
+    for (int fd : toClose)
+        ring.prepareClose(fd, kCloseTag);
+    // Results are complete even if the ring fails while closing
+    drain(unsigned(toClose.size()), [](uint64_t, int) {});
+    return true;
+}
+
+#else
+
+bool LibraryScanner::scanIoUring(const std::vector<std::string>&, unsigned, std::vector<TrackMetadata>&)
+{
+    return false;
+}
+
+#endif
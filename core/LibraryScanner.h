@@ -0,0 +1,34 @@
+#pragma once
+
+#include "TrackMetadata.h"
+
+#include <string>
+#include <vector>
+
+// Reads metadata for a whole batch of files, as when loading a session or
+// adding a folder.
+//
+// On Linux the io_uring backend stats every file in one batch, visits them
+// in inode order (close to on-disk order, so a cold scan seeks forward
+// instead of back and forth) and keeps a window of opens and reads in
+// flight at once. Like Mp3Reader::read() it only reads past the first part
+// of a big tag, or the ID3v1 tail, when a wanted field is still missing.
+// Files in other formats are handed to TagReaders once the head read has
+// identified them. Where io_uring is unavailable the scan falls back to
+// TagReaders::read() per file.
+class LibraryScanner {
+public:
+    enum class Backend { Auto, Sync, IoUring };
+
+    // Results are in the same order as files; fields as for TrackMetadata
+    static std::vector<TrackMetadata> scan(const std::vector<std::string>& files,
+                                         unsigned fields = TrackMetadata::AllFields,
+                                         Backend backend = Backend::Auto);
+
+    static bool ioUringAvailable();
+
+private:
+    static std::vector<TrackMetadata> scanSync(const std::vector<std::string>& files, unsigned fields);
+    static bool scanIoUring(const std::vector<std::string>& files, unsigned fields,
+                            std::vector<TrackMetadata>& out);
+};
@@ -0,0 +1,249 @@
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+constexpr size_t kTags = size_t(MemoryTag::Count);
+
+const char* const kNames[kTags] = {
+    "other", "tracks", "playlist", "collation", "groups", "scan", "audio", "ui",
+};
+
+// Plain atomics, so they are ready before any static constructor allocates
+struct Counter {
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> peak{0};
+    std::atomic<int64_t> allocations{0};
+};
+
+Counter counters[kTags];
+Counter total;
+
+void raise(std::atomic<int64_t>& peak, int64_t value)
+{
+    int64_t seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+void add(Counter& counter, int64_t bytes, int64_t allocations)
+{
+    int64_t now = counter.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    counter.allocations.fetch_add(allocations, std::memory_order_relaxed);
+    if (bytes > 0)
+        raise(counter.peak, now);
+}
+
+std::string human(int64_t bytes)
+{
+    char text[32];
+    if (bytes < 0)
+        return "?";
+    if (bytes < 1024)
+        std::snprintf(text, sizeof(text), "%lld B", (long long)bytes);
+    else if (bytes < 1024 * 1024)
+        std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    else if (bytes < 1024ll * 1024 * 1024)
+        std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024));
+    else
+        std::snprintf(text, sizeof(text), "%.2f GB", bytes / (1024.0 * 1024 * 1024));
+    return text;
+}
+
+std::string perTrack(int64_t bytes, size_t trackCount)
+{
+    return trackCount && bytes >= 0 ? human(bytes / int64_t(trackCount)) : "-";
+}
+
+}
+
+bool MemoryStats::enabled()
+{
+#ifdef PLAYER_MEMORY_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<MemoryStats::Usage> MemoryStats::usage()
+{
+    std::vector<Usage> out;
+    if (!enabled())
+        return out;
+    for (size_t i = 0; i < kTags; ++i) {
+        out.push_back({ MemoryTag(i), kNames[i],
+                        counters[i].bytes.load(std::memory_order_relaxed),
+                        counters[i].peak.load(std::memory_order_relaxed),
+                        uint64_t(counters[i].allocations.load(std::memory_order_relaxed)) });
+    }
+    return out;
+}
+
+int64_t MemoryStats::trackedBytes()
+{
+    return total.bytes.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryStats::trackedPeak()
+{
+    return total.peak.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryStats::heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    return int64_t(info.uordblks + info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+int64_t MemoryStats::peakResident()
+{
+#ifdef __linux__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return int64_t(usage.ru_maxrss) * 1024;
+#endif
+    return -1;
+}
+
+std::string MemoryStats::report(size_t trackCount)
+{
+    std::string out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "memory, %zu tracks\n", trackCount);
+    out += line;
+    std::snprintf(line, sizeof(line), "  %-14s %11s %11s %10s %11s\n",
+                  "", "live", "peak", "allocs", "per track");
+    out += line;
+
+    for (const Usage& u : usage()) {
+        std::snprintf(line, sizeof(line), "  %-14s %11s %11s %10llu %11s\n",
+                      u.name, human(u.bytes).c_str(), human(u.peak).c_str(),
+                      (unsigned long long)u.allocations, perTrack(u.bytes, trackCount).c_str());
+        out += line;
+    }
+    if (enabled()) {
+        std::snprintf(line, sizeof(line), "  %-14s %11s %11s %10s %11s\n",
+                      "all counted", human(trackedBytes()).c_str(), human(trackedPeak()).c_str(), "",
+                      perTrack(trackedBytes(), trackCount).c_str());
+        out += line;
+    } else {
+        out += "  (per-subsystem counts need a build with -DMEMORY_STATS=ON)\n";
+    }
+
+    std::snprintf(line, sizeof(line), "  %-14s %11s %11s %10s %11s\n",
+                  "malloc heap", human(heapInUse()).c_str(), "", "", perTrack(heapInUse(), trackCount).c_str());
+    out += line;
+    std::snprintf(line, sizeof(line), "  %-14s %11s %11s\n",
+                  "resident", "", human(peakResident()).c_str());
+    out += line;
+    return out;
+}
+
+void MemoryStats::allocated(MemoryTag tag, size_t bytes)
+{
+    add(counters[size_t(tag)], int64_t(bytes), 1);
+    add(total, int64_t(bytes), 1);
+}
+
+void MemoryStats::released(MemoryTag tag, size_t bytes)
+{
+    add(counters[size_t(tag)], -int64_t(bytes), -1);
+    add(total, -int64_t(bytes), -1);
+}
+
+#ifdef PLAYER_MEMORY_STATS
+
+namespace {
+
+thread_local MemoryTag currentTag = MemoryTag::Other;
+
+// Each block is prefixed with its size and tag; the prefix keeps the
+// default new alignment
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Prefix {
+    size_t size;
+    MemoryTag tag;
+};
+
+void* allocate(size_t size)
+{
+    for (;;) {
+        if (void* block = std::malloc(sizeof(Prefix) + size)) {
+            Prefix* prefix = static_cast<Prefix*>(block);
+            prefix->size = size;
+            prefix->tag = currentTag;
+            MemoryStats::allocated(prefix->tag, size);
+            return prefix + 1;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* allocateNoThrow(size_t size) noexcept
+{
+    try {
+        return allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void release(void* pointer)
+{
+    if (!pointer)
+        return;
+    Prefix* prefix = static_cast<Prefix*>(pointer) - 1;
+    MemoryStats::released(prefix->tag, prefix->size);
+    std::free(prefix);
+}
+
+}
+
+MemoryScope::MemoryScope(MemoryTag tag)
+    : previous(currentTag)
+{
+    currentTag = tag;
+}
+
+MemoryScope::~MemoryScope()
+{
+    currentTag = previous;
+}
+
+MemoryTag MemoryScope::current()
+{
+    return currentTag;
+}
+
+// Over-aligned new/delete keep their default implementations, which do
+// not go through these
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocateNoThrow(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocateNoThrow(size); }
+void operator delete(void* pointer) noexcept { release(pointer); }
+void operator delete[](void* pointer) noexcept { release(pointer); }
+void operator delete(void* pointer, size_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+
+#endif
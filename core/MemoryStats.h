@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where heap memory goes, per subsystem, for `player --stats` and the GUI
+// memory panel.
+//
+// With the MEMORY_STATS build option every operator new is counted against
+// the subsystem of the innermost MemoryScope active on the allocating
+// thread (Other outside any scope); the matching delete is credited back
+// to the same subsystem wherever it happens. Memory Qt or C code gets from
+// malloc directly (QString text, for one) is not seen per subsystem, only
+// in the process-wide heap figure.
+//
+// Without the option scopes compile to nothing and usage() is empty; the
+// process-wide figures still work.
+enum class MemoryTag : uint8_t {
+    Other,
+    Tracks,    // Track records and their strings (TrackStore)
+    Playlist,  // sequences, undo history, playback order
+    Collation, // cached sort keys
+    Groups,    // artist/album index
+    Scan,      // metadata scan buffers
+    Audio,     // decode and spectrum buffers
+    Ui,        // table and tree items
+    Count
+};
+
+class MemoryStats {
+public:
+    struct Usage {
+        MemoryTag tag;
+        const char* name;
+        int64_t bytes;        // live now
+        int64_t peak;         // most live at any one time
+        uint64_t allocations; // live now
+    };
+
+    // Built with MEMORY_STATS
+    static bool enabled();
+
+    // One entry per subsystem, in MemoryTag order
+    static std::vector<Usage> usage();
+    // Sum of all subsystems now, and its peak
+    static int64_t trackedBytes();
+    static int64_t trackedPeak();
+
+    // As malloc sees it (glibc), -1 when unknown
+    static int64_t heapInUse();
+    // Peak resident set size of the process, -1 when unknown
+    static int64_t peakResident();
+
+    // Table of the above with per-track figures, for printing
+    static std::string report(size_t trackCount);
+
+    // Called by the counting operator new / delete
+    static void allocated(MemoryTag tag, size_t bytes);
+    static void released(MemoryTag tag, size_t bytes);
+};
+
+// Attributes this thread's allocations to tag until destroyed
+class MemoryScope {
+public:
+    explicit MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+    static MemoryTag current();
+
+private:
+    MemoryTag previous;
+};
+
+#ifndef PLAYER_MEMORY_STATS
+inline MemoryScope::MemoryScope(MemoryTag) : previous(MemoryTag::Other) {}
+inline MemoryScope::~MemoryScope() {}
+inline MemoryTag MemoryScope::current() { return MemoryTag::Other; }
+#endif
@@ -0,0 +1,185 @@
+#include "MetadataLoader.h"
+#include "LibraryScanner.h"
+#include "MemoryStats.h"
+
+#include <algorithm>
+
+MetadataLoader::MetadataLoader(Config config)
+    : config(config)
+{
+    worker = std::thread(&MetadataLoader::run, this);
+}
+
+MetadataLoader::~MetadataLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+Track MetadataLoader::placeholder(const std::string& filename)
+{
+    Track t;
+    t.filename = filename;
+    t.title = filename.substr(filename.find_last_of('/') + 1);
+    t.lengthSeconds = 0;
+    return t;
+}
+
+void MetadataLoader::enqueue(const PlaylistImpl& playlist, size_t first, size_t end)
+{
+    MemoryScope scope(MemoryTag::Scan);
+    end = std::min(end, playlist.size());
+    if (first >= end)
+        return;
+
+    // Indexing walks the tree per row; one pass over the snapshot does
+    // not, but costs the whole playlist, so a few rows are indexed
+    std::vector<TrackId> ids;
+    std::vector<std::string> files;
+    ids.reserve(end - first);
+    files.reserve(end - first);
+    const PlaylistImpl::Snapshot rows = playlist.snapshot();
+    if ((end - first) * 64 < rows.size()) {
+        for (size_t index = first; index < end; ++index) {
+            ids.push_back(rows[index].id);
+            files.push_back(rows[index].track->filename);
+        }
+    } else {
+        size_t index = 0;
+        rows.forEach([&](const PlaylistImpl::Entry& e) {
+            if (index >= first && index < end) {
+                ids.push_back(e.id);
+                files.push_back(e.track->filename);
+            }
+            ++index;
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        waiting.reserve(waiting.size() + ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            waiting[ids[i]] = std::move(files[i]);
+            background.push_back(ids[i]);
+        }
+    }
+    wake.notify_one();
+}
+
+void MetadataLoader::setVisible(const PlaylistImpl& playlist, size_t first, size_t end)
+{
+    std::vector<TrackId> ids;
+    for (size_t index = first; index < std::min(end, playlist.size()); ++index)
+        ids.push_back(playlist.idAt(index));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    visible.swap(ids);
+}
+
+void MetadataLoader::follow(const PlaylistImpl& playlist)
+{
+    std::vector<TrackId> ids;
+    if (playlist.currentIndex() >= 0)
+        ids.push_back(playlist.idAt(size_t(playlist.currentIndex())));
+    for (size_t index : playlist.upcoming(config.lookahead))
+        ids.push_back(playlist.idAt(index));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    upcoming.swap(ids);
+}
+
+std::vector<TrackId> MetadataLoader::apply(Library& library)
+{
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.swap(done);
+    }
+
+    std::vector<TrackId> updated;
+    updated.reserve(results.size());
+    const TrackStore& store = library.tracks();
+    for (Result& result : results) {
+        // The id may have been freed, or handed to another file since
+        if (result.id >= store.idLimit() || !store.get(result.id)
+            || store.get(result.id)->filename != result.filename)
+            continue;
+
+        const TrackMetadata& data = result.metadata;
+        Track t = *store.get(result.id);
+        // Untagged files keep the file name they were added with
+        if (!data.title.empty())
+            t.title = data.title;
+        t.artist = data.artist;
+        t.album  = data.album;
+        t.lengthSeconds = data.lengthSeconds;
+        t.trackNumber = data.trackNumber;
+        t.year = data.year;
+        library.update(result.id, t);
+        updated.push_back(result.id);
+    }
+    return updated;
+}
+
+size_t MetadataLoader::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return waiting.size() + reading + done.size();
+}
+
+void MetadataLoader::run()
+{
+    for (;;) {
+        std::vector<TrackId> ids;
+        std::vector<std::string> files;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !waiting.empty(); });
+            if (stopping)
+                return;
+            pick(ids, files);
+            reading = ids.size();
+        }
+
+        std::vector<TrackMetadata> tags = LibraryScanner::scan(files, TrackMetadata::TrackFields);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < ids.size(); ++i)
+                done.push_back({ ids[i], std::move(files[i]), std::move(tags[i]) });
+            reading = 0;
+        }
+        if (wakeup)
+            wakeup();
+    }
+}
+
+void MetadataLoader::pick(std::vector<TrackId>& ids, std::vector<std::string>& files)
+{
+    auto take = [&](TrackId id) {
+        auto it = waiting.find(id);
+        if (it == waiting.end())
+            return;
+        ids.push_back(id);
+        files.push_back(std::move(it->second));
+        waiting.erase(it);
+    };
+
+    // One tier per batch, so rows on screen never wait behind the rest
+    for (size_t i = 0; i < visible.size() && ids.size() < config.batchSize; ++i)
+        take(visible[i]);
+    if (ids.empty()) {
+        for (size_t i = 0; i < upcoming.size() && ids.size() < config.batchSize; ++i)
+            take(upcoming[i]);
+    }
+    if (!ids.empty())
+        return;
+    while (ids.size() < config.batchSize && !background.empty()) {
+        take(background.front());
+        background.pop_front();
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Library.h"
+#include "TrackMetadata.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reads tags for tracks that went into a playlist with only their file
+// names, so an import of any size shows its rows straight away.
+//
+// A worker thread reads tags in batches through LibraryScanner and takes
+// waiting tracks in priority order: the rows on screen first, then the
+// next few to play, then everything else in the order it was queued. The
+// frontends report the visible rows and the playing position as they
+// change. Tags that have been read wait until the owner collects them on
+// its own thread with apply(), since the library is single-threaded.
+class MetadataLoader {
+public:
+    struct Config {
+        size_t batchSize = 32; // files per LibraryScanner::scan
+        size_t lookahead = 8;  // upcoming tracks served before the rest
+    };
+
+    MetadataLoader() : MetadataLoader(Config()) {}
+    explicit MetadataLoader(Config config);
+    ~MetadataLoader();
+
+    MetadataLoader(const MetadataLoader&) = delete;
+    MetadataLoader& operator=(const MetadataLoader&) = delete;
+
+    // What to add before the tags are known: the file name as the title
+    static Track placeholder(const std::string& filename);
+
+    // Queues the tags of rows [first, end) of playlist, added as placeholders
+    void enqueue(const PlaylistImpl& playlist, size_t first, size_t end);
+    // Rows [first, end) of playlist are on screen; replaces the last call
+    void setVisible(const PlaylistImpl& playlist, size_t first, size_t end);
+    // The current track and the ones after it in playback order
+    void follow(const PlaylistImpl& playlist);
+
+    // Called on the worker thread when apply() has something to do. Set it
+    // before the first enqueue().
+    void setWakeup(std::function<void()> wake) { wakeup = std::move(wake); }
+    // Writes the tags read so far into the library and returns the ids of
+    // the tracks updated. Tracks removed from the library meanwhile are
+    // skipped.
+    std::vector<TrackId> apply(Library& library);
+
+    // Tracks queued whose tags are not applied yet
+    size_t pending() const;
+
+private:
+    struct Result {
+        TrackId id;
+        std::string filename;
+        TrackMetadata metadata;
+    };
+
+    void run();
+    // Up to batchSize waiting tracks, all from the most urgent tier
+    void pick(std::vector<TrackId>& ids, std::vector<std::string>& files);
+
+    const Config config;
+    std::function<void()> wakeup;
+
+    // Guarded by mutex
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<TrackId, std::string> waiting; // queued, not read yet
+    std::deque<TrackId> background; // queue order; ids read since are skipped
+    std::vector<TrackId> visible;
+    std::vector<TrackId> upcoming;
+    std::vector<Result> done;
+    size_t reading = 0; // in the batch being read
+    bool stopping = false;
+
+    std::thread worker;
+};
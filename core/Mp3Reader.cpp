@@ -1,4 +1,5 @@
 #include "Mp3Reader.h"
+#include "TagText.h"
 #include <fstream>
 #include <vector>
 #include <array>
@@ -15,6 +16,92 @@ static uint32_t synchsafeToInt(const std::array<unsigned char,4>& bytes) {
     return (bytes[0] << 21) | (bytes[1] << 14) | (bytes[2] << 7) | (bytes[3]);
 }
 
+static uint32_t bigEndianToInt(const char* p) {
+    return ((unsigned char)p[0]<<24) | ((unsigned char)p[1]<<16) |
+           ((unsigned char)p[2]<<8) | (unsigned char)p[3];
+}
+
+// Frame IDs packed into an int, so frames can be told apart with one switch
+static constexpr uint32_t frameId(const char* id) {
+    return (uint32_t((unsigned char)id[0])<<24) | (uint32_t((unsigned char)id[1])<<16) |
+           (uint32_t((unsigned char)id[2])<<8) | uint32_t((unsigned char)id[3]);
+}
+
+// The field a frame fills, 0 for frames we don't read
+static unsigned fieldFor(uint32_t id) {
+    switch (id) {
+    case frameId("TIT2"): return TrackMetadata::Title;
+    case frameId("TPE1"): return TrackMetadata::Artist;
+    case frameId("TALB"): return TrackMetadata::Album;
+    case frameId("TLEN"): return TrackMetadata::Length;
+    case frameId("TRCK"): return TrackMetadata::TrackNumber;
+    case frameId("TPOS"): return TrackMetadata::Disc;
+    case frameId("TYER"):
+    case frameId("TDRC"): return TrackMetadata::Year;
+    case frameId("TCON"): return TrackMetadata::Genre;
+    default: return 0;
+    }
+}
+
+// Fields an ID3v1 block can supply
+static constexpr unsigned kId3v1Fields = TrackMetadata::Title | TrackMetadata::Artist | TrackMetadata::Album |
+                                         TrackMetadata::TrackNumber | TrackMetadata::Year | TrackMetadata::Genre;
+
+// read() fetches the tag in growing steps starting with this many bytes
+static constexpr size_t kFirstRead = 16 * 1024;
+
+// An MPEG audio frame header, decoded
+struct FrameHeader {
+    int sampleRate;      // Hz
+    int bitrate;         // bits per second
+    int samplesPerFrame;
+    size_t size;         // bytes, header included
+    size_t sideInfo;     // bytes between the header and a Xing / Info tag
+};
+
+static bool decodeFrameHeader(const unsigned char* p, FrameHeader& frame) {
+    if (p[0]!=0xFF || (p[1] & 0xE0)!=0xE0) return false;
+    const int version = (p[1]>>3) & 3;     // 0: MPEG 2.5, 2: MPEG 2, 3: MPEG 1
+    const int layer = 4 - ((p[1]>>1) & 3); // 1, 2 or 3
+    const int bitrateIndex = p[2]>>4;
+    const int rateIndex = (p[2]>>2) & 3;
+    if (version==1 || layer==4 || bitrateIndex==0 || bitrateIndex==15 || rateIndex==3) return false;
+
+    // kbit/s by bitrate index
+    static const short kMpeg1[3][15] = {
+        {0,32,64,96,128,160,192,224,256,288,320,352,384,416,448},
+        {0,32,48,56,64,80,96,112,128,160,192,224,256,320,384},
+        {0,32,40,48,56,64,80,96,112,128,160,192,224,256,320},
+    };
+    static const short kMpeg2[2][15] = {
+        {0,32,48,56,64,80,96,112,128,144,160,176,192,224,256},
+        {0,8,16,24,32,40,48,56,64,80,96,112,128,144,160}, // layers II and III
+    };
+    static const int kRates[3] = {44100, 48000, 32000};
+
+    const bool mpeg1 = version==3;
+    const bool mono = (p[3]>>6)==3;
+    const int padding = (p[2]>>1) & 1;
+    frame.bitrate = 1000 * (mpeg1 ? kMpeg1[layer-1][bitrateIndex] : kMpeg2[layer==1 ? 0 : 1][bitrateIndex]);
+    frame.sampleRate = kRates[rateIndex] >> (mpeg1 ? 0 : version==2 ? 1 : 2);
+    frame.samplesPerFrame = layer==1 ? 384 : (layer==3 && !mpeg1) ? 576 : 1152;
+    frame.size = layer==1 ? size_t(12*frame.bitrate/frame.sampleRate + padding) * 4
+                          : size_t(frame.samplesPerFrame/8 * frame.bitrate/frame.sampleRate + padding);
+    frame.sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    return true;
+}
+
+// Undo unsynchronisation: the writer put a 00 after every FF
+static std::vector<char> resynchronise(const char* data, size_t size) {
+    std::vector<char> out;
+    out.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        out.push_back(data[i]);
+        if ((unsigned char)data[i]==0xFF && i+1 < size && data[i+1]==0) ++i;
+    }
+    return out;
+}
+
 // Remove nulls and trim spaces
 static std::string cleanString(const std::string& s) {
     std::string out;
@@ -26,8 +113,8 @@ static std::string cleanString(const std::string& s) {
 }
 
 // Minimal UTF-16 decoding (ASCII subset only)
-static std::string decodeUTF16(const std::vector<char>& data) {
-    if (data.size() < 2) return "";
+static std::string decodeUTF16(const char* data, size_t size) {
+    if (size < 2) return "";
     std::string out;
     bool isLE = false;
     size_t pos = 0;
@@ -36,7 +123,7 @@ static std::string decodeUTF16(const std::vector<char>& data) {
     if ((unsigned char)data[0]==0xFF && (unsigned char)data[1]==0xFE) { isLE = true; pos=2; }
     else if ((unsigned char)data[0]==0xFE && (unsigned char)data[1]==0xFF) { isLE=false; pos=2; }
 
-    for (; pos+1 < data.size(); pos+=2) {
+    for (; pos+1 < size; pos+=2) {
         uint16_t c = isLE ? ((unsigned char)data[pos] | ((unsigned char)data[pos+1]<<8))
                           : (((unsigned char)data[pos]<<8) | (unsigned char)data[pos+1]);
         if (c < 128) out += (char)c;
@@ -44,101 +131,271 @@ static std::string decodeUTF16(const std::vector<char>& data) {
     return cleanString(out);
 }
 
+// Text frame body: an encoding byte, then the text
+static std::string textValue(const char* data, size_t size) {
+    if (size <= 1) return "";
+    uint8_t encoding = (unsigned char)data[0];
+    if (encoding==0 || encoding==3) return cleanString(std::string(data+1, size-1)); // Latin-1, UTF-8
+    if (encoding==1 || encoding==2) return decodeUTF16(data+1, size-1);
+    return "";
+}
+
+// TCON is free text, an ID3v1 genre number ("17", "(17)") or a number
+// followed by a refinement ("(17)Southern Rock")
+static std::string genreName(const std::string& value) {
+    size_t pos = 0;
+    if (!value.empty() && value[0]=='(') {
+        size_t close = value.find(')');
+        if (close == std::string::npos) return value;
+        if (close+1 < value.size()) return value.substr(close+1);
+        std::string inner = value.substr(1, close-1);
+        if (inner=="RX") return "Remix";
+        if (inner=="CR") return "Cover";
+        return id3v1Genre(leadingInt(inner, pos));
+    }
+    int n = leadingInt(value, pos);
+    if (pos > 0 && pos == value.size()) return id3v1Genre(n);
+    return value;
+}
+
+static void store(unsigned field, const std::string& value, TrackMetadata& meta) {
+    size_t pos = 0;
+    switch (field) {
+    case TrackMetadata::Title:       meta.title = value; break;
+    case TrackMetadata::Artist:      meta.artist = value; break;
+    case TrackMetadata::Album:       meta.album = value; break;
+    case TrackMetadata::Length:      meta.lengthSeconds = leadingInt(value, pos)/1000; break;
+    case TrackMetadata::TrackNumber: numberPair(value, meta.trackNumber, meta.trackCount); break;
+    case TrackMetadata::Disc:        numberPair(value, meta.discNumber, meta.discCount); break;
+    case TrackMetadata::Year:        meta.year = leadingInt(value, pos); break; // "2004" or "2004-05-01"
+    case TrackMetadata::Genre:       meta.genre = genreName(value); break;
+    }
+}
+
 // -----------------------------
 // Mp3Reader Implementation
 // -----------------------------
-Mp3Metadata Mp3Reader::read(const std::string& filename) {
-    Mp3Metadata meta = {"Unknown Title", "Unknown Artist", "Unknown Album", 0};
-
+TrackMetadata Mp3Reader::read(const std::string& filename, unsigned fields) {
     std::ifstream file(filename, std::ios::binary);
-    if (!file) return meta;
-
-    // -------- ID3v2 detection --------
-    char header[10];
-    file.read(header,10);
-    if (file.gcount()==10 && header[0]=='I' && header[1]=='D' && header[2]=='3') {
-        uint8_t version = header[3]; // 3=v2.3, 4=v2.4
-        uint8_t flags   = header[5];
-        std::array<unsigned char,4> sizeBytes = {
-            (unsigned char)header[6], (unsigned char)header[7],
-            (unsigned char)header[8], (unsigned char)header[9]
-        };
-        uint32_t tagSize = synchsafeToInt(sizeBytes);
-
-        std::vector<char> tagData(tagSize);
-        file.read(tagData.data(), tagSize);
+    if (!file) return TrackMetadata();
+    return read(file, fields);
+}
 
-        size_t pos = 0;
-        // Skip extended header if present
-        if (flags & 0x40 && tagData.size() >= 4) {
-            uint32_t extHeaderSize = synchsafeToInt({
-                (unsigned char)tagData[0], (unsigned char)tagData[1],
-                (unsigned char)tagData[2], (unsigned char)tagData[3]
-            });
-            pos = (version==3) ? (extHeaderSize + 4) : extHeaderSize;
-        }
+TrackMetadata Mp3Reader::read(std::istream& file, unsigned fields) {
+    TrackMetadata meta;
+    std::vector<char> head(10);
+    file.read(head.data(), 10);
+    head.resize(file.gcount());
+
+    // Text frames tend to come first and cover art last, so read the tag a
+    // piece at a time and stop once everything wanted has turned up
+    const size_t tagEnd = headSize(head.data(), head.size());
+    unsigned found = 0;
+    size_t step = kFirstRead;
+    while (head.size() < tagEnd) {
+        size_t have = head.size();
+        size_t next = std::min(tagEnd, have + step);
+        head.resize(next);
+        file.read(head.data() + have, next - have);
+        head.resize(have + file.gcount());
 
-        while (pos+10 <= tagData.size()) {
-            if ((unsigned char)tagData[pos]==0) break; // padding
-
-            std::string frameID(tagData.data()+pos,4);
-            uint32_t frameSize = 0;
-            if (version==3) { // v2.3
-                frameSize = ((unsigned char)tagData[pos+4]<<24) |
-                            ((unsigned char)tagData[pos+5]<<16) |
-                            ((unsigned char)tagData[pos+6]<<8) |
-                            ((unsigned char)tagData[pos+7]);
-            } else { // v2.4
-                frameSize = synchsafeToInt({
-                    (unsigned char)tagData[pos+4], (unsigned char)tagData[pos+5],
-                    (unsigned char)tagData[pos+6], (unsigned char)tagData[pos+7]
-                });
-            }
-
-            if (frameSize==0 || pos+10+frameSize > tagData.size()) break;
-
-            const char* dataPtr = tagData.data()+pos+10;
-            std::string value;
-
-            if (frameSize>1) {
-                uint8_t encoding = (unsigned char)dataPtr[0];
-                if (encoding==0) value = cleanString(std::string(dataPtr+1, frameSize-1));
-                else if (encoding==1 || encoding==2) {
-                    std::vector<char> content(dataPtr+1, dataPtr+frameSize);
-                    value = decodeUTF16(content);
-                }
-            }
-
-            if (frameID=="TIT2") meta.title  = value;
-            else if (frameID=="TPE1") meta.artist = value;
-            else if (frameID=="TALB") meta.album  = value;
-            else if (frameID=="TLEN") {
-                try { meta.lengthSeconds = std::stoi(value)/1000; } catch(...) { meta.lengthSeconds=0; }
-            }
-
-            pos += 10 + frameSize;
+        found = parseHead(head.data(), head.size(), fields, meta);
+        if ((found & fields) == fields || head.size() < next) break;
+        step *= 4;
+    }
+
+    if (fields & ~found & TrackMetadata::Length) {
+        // No TLEN frame: work it out from the audio
+        const size_t start = audioStart(head.data(), head.size());
+        file.clear();
+        file.seekg(0, std::ios::end);
+        const std::streampos end = file.tellg();
+        if (end > std::streampos(start)) {
+            char frames[kFrameProbeSize];
+            file.seekg(std::streamoff(start));
+            file.read(frames, kFrameProbeSize);
+            meta.lengthSeconds = estimateLength(frames, size_t(file.gcount()), uint64_t(end) - start);
         }
     }
 
-    // -------- ID3v1 fallback --------
+    if (!wantsTail(fields, found)) return meta;
+
+    file.clear();
     file.seekg(0, std::ios::end);
     std::streampos filesize = file.tellg();
-    if (filesize >= 128) {
-        file.seekg(-128, std::ios::end);
-        char id3v1[128];
-        file.read(id3v1,128);
-        if (id3v1[0]=='T' && id3v1[1]=='A' && id3v1[2]=='G') {
-            auto trim = [](const char* s,size_t len){
-                std::string str(s,len);
-                str.erase(std::find_if(str.rbegin(), str.rend(),
-                    [](unsigned char ch){ return !std::isspace(ch)&&ch!='\0'; }).base(), str.end());
-                return str;
-            };
-            if(meta.title=="Unknown Title")  meta.title  = cleanString(trim(&id3v1[3],30));
-            if(meta.artist=="Unknown Artist") meta.artist = cleanString(trim(&id3v1[33],30));
-            if(meta.album=="Unknown Album")   meta.album  = cleanString(trim(&id3v1[63],30));
+    if (filesize >= std::streampos(kTailSize)) {
+        char tail[kTailSize];
+        file.seekg(-std::streamoff(kTailSize), std::ios::end);
+        file.read(tail, kTailSize);
+        if (file.gcount() == std::streamsize(kTailSize))
+            parseTail(tail, fields, found, meta);
+    }
+    return meta;
+}
+
+bool Mp3Reader::sniff(const char* head, size_t length) {
+    if (length>=3 && head[0]=='I' && head[1]=='D' && head[2]=='3') return true;
+    // MPEG audio frame sync
+    return length>=2 && (unsigned char)head[0]==0xFF && ((unsigned char)head[1] & 0xE0)==0xE0;
+}
+
+size_t Mp3Reader::headSize(const char* header, size_t length) {
+    if (length < 10 || header[0]!='I' || header[1]!='D' || header[2]!='3')
+        return 10;
+    std::array<unsigned char,4> sizeBytes = {
+        (unsigned char)header[6], (unsigned char)header[7],
+        (unsigned char)header[8], (unsigned char)header[9]
+    };
+    return 10 + synchsafeToInt(sizeBytes);
+}
+
+size_t Mp3Reader::audioStart(const char* header, size_t length) {
+    if (length < 10 || header[0]!='I' || header[1]!='D' || header[2]!='3') return 0;
+    // v2.4 may end the tag with a copy of its header
+    return headSize(header, length) + ((header[3]==4 && (header[5] & 0x10)) ? 10 : 0);
+}
+
+int Mp3Reader::estimateLength(const char* frames, size_t length, uint64_t audioBytes) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(frames);
+    for (size_t pos = 0; pos + 4 <= length; ++pos) {
+        FrameHeader frame;
+        if (!decodeFrameHeader(data + pos, frame)) continue;
+        // Stray sync bits are common; a real frame is followed by another
+        if (pos + frame.size + 4 <= length) {
+            FrameHeader next;
+            if (!decodeFrameHeader(data + pos + frame.size, next) || next.sampleRate != frame.sampleRate)
+                continue;
         }
+
+        // VBR encoders put the total frame count in the first frame
+        uint32_t frameCount = 0;
+        const size_t xing = pos + 4 + frame.sideInfo;
+        const size_t vbri = pos + 4 + 32;
+        if (xing + 12 <= length && (std::equal(frames + xing, frames + xing + 4, "Xing") ||
+                                    std::equal(frames + xing, frames + xing + 4, "Info"))) {
+            if (bigEndianToInt(frames + xing + 4) & 1)
+                frameCount = bigEndianToInt(frames + xing + 8);
+        } else if (vbri + 18 <= length && std::equal(frames + vbri, frames + vbri + 4, "VBRI")) {
+            frameCount = bigEndianToInt(frames + vbri + 14);
+        }
+        if (frameCount)
+            return int(uint64_t(frameCount) * frame.samplesPerFrame / frame.sampleRate);
+
+        // Otherwise assume a constant bitrate
+        const uint64_t bytes = audioBytes > pos ? audioBytes - pos : 0;
+        return int(bytes * 8 / frame.bitrate);
     }
+    return 0;
+}
 
+TrackMetadata Mp3Reader::parse(const char* head, size_t headLength, const char* tail, unsigned fields) {
+    TrackMetadata meta;
+    unsigned found = parseHead(head, headLength, fields, meta);
+    if (tail && wantsTail(fields, found))
+        parseTail(tail, fields, found, meta);
     return meta;
 }
+
+unsigned Mp3Reader::parseHead(const char* head, size_t headLength, unsigned fields, TrackMetadata& meta) {
+    const char* header = head;
+    if (headLength<10 || header[0]!='I' || header[1]!='D' || header[2]!='3') return 0;
+
+    uint8_t version = header[3]; // 3=v2.3, 4=v2.4
+    uint8_t flags   = header[5];
+    if (version!=3 && version!=4) return 0;
+    size_t tagSize = std::min(headSize(header, headLength), headLength) - 10;
+
+    // v2.3 unsynchronises the tag as a whole, v2.4 frame by frame
+    const char* tagData = head + 10;
+    std::vector<char> resynced;
+    if (version==3 && (flags & 0x80)) {
+        resynced = resynchronise(tagData, tagSize);
+        tagData = resynced.data();
+        tagSize = resynced.size();
+    }
+
+    size_t pos = 0;
+    // Skip extended header if present
+    if (flags & 0x40 && tagSize >= 4) {
+        pos = (version==3) ? bigEndianToInt(tagData) + 4
+                           : synchsafeToInt({
+                                 (unsigned char)tagData[0], (unsigned char)tagData[1],
+                                 (unsigned char)tagData[2], (unsigned char)tagData[3]
+                             });
+    }
+
+    unsigned found = 0;
+    while (pos+10 <= tagSize && (found & fields) != fields) {
+        const char* frame = tagData + pos;
+        if ((unsigned char)frame[0]==0) break; // padding
+
+        uint32_t frameSize = (version==3) ? bigEndianToInt(frame+4)
+                                          : synchsafeToInt({
+                                                (unsigned char)frame[4], (unsigned char)frame[5],
+                                                (unsigned char)frame[6], (unsigned char)frame[7]
+                                            });
+        if (frameSize==0 || pos+10+frameSize > tagSize) break;
+        pos += 10 + frameSize;
+
+        unsigned field = fieldFor(frameId(frame)) & fields;
+        if (!field) continue;
+
+        // Format flags: skip compressed and encrypted frames, step over
+        // group ids and (v2.4) data length indicators
+        const char* data = frame + 10;
+        size_t size = frameSize;
+        uint8_t format = frame[9];
+        bool unsynced = false;
+        size_t prefix = 0;
+        if (version==3) {
+            if (format & 0xC0) continue;
+            if (format & 0x20) prefix += 1;
+        } else {
+            if (format & 0x0C) continue;
+            if (format & 0x40) prefix += 1;
+            if (format & 0x01) prefix += 4;
+            unsynced = (format & 0x02) || (flags & 0x80);
+        }
+        if (prefix > size) continue;
+        data += prefix;
+        size -= prefix;
+
+        if (unsynced) {
+            std::vector<char> plain = resynchronise(data, size);
+            store(field, textValue(plain.data(), plain.size()), meta);
+        } else {
+            store(field, textValue(data, size), meta);
+        }
+        found |= field;
+    }
+    return found;
+}
+
+bool Mp3Reader::wantsTail(unsigned fields, unsigned found) {
+    return (fields & ~found & kId3v1Fields) != 0;
+}
+
+void Mp3Reader::parseTail(const char* tail, unsigned fields, unsigned found, TrackMetadata& meta) {
+    const char* id3v1 = tail;
+    if (id3v1[0]!='T' || id3v1[1]!='A' || id3v1[2]!='G') return;
+
+    auto trim = [](const char* s,size_t len){
+        std::string str(s,len);
+        str.erase(std::find_if(str.rbegin(), str.rend(),
+            [](unsigned char ch){ return !std::isspace(ch)&&ch!='\0'; }).base(), str.end());
+        return str;
+    };
+    unsigned missing = fields & ~found;
+    if (missing & TrackMetadata::Title)  meta.title  = cleanString(trim(&id3v1[3],30));
+    if (missing & TrackMetadata::Artist) meta.artist = cleanString(trim(&id3v1[33],30));
+    if (missing & TrackMetadata::Album)  meta.album  = cleanString(trim(&id3v1[63],30));
+    if (missing & TrackMetadata::Year) {
+        size_t pos = 0;
+        meta.year = leadingInt(std::string(&id3v1[93],4), pos);
+    }
+    // ID3v1.1 keeps the track number in the last byte of the comment
+    if ((missing & TrackMetadata::TrackNumber) && id3v1[125]==0 && id3v1[126]!=0)
+        meta.trackNumber = (unsigned char)id3v1[126];
+    if (missing & TrackMetadata::Genre)
+        meta.genre = id3v1Genre((unsigned char)id3v1[127]);
+}
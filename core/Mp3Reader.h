@@ -1,21 +1,54 @@
 #ifndef MP3READER_H
 #define MP3READER_H
 
+#include "TrackMetadata.h"
+
 #include <string>
 #include <fstream>
 #include <array>
 #include <algorithm>
 
-struct Mp3Metadata {
-    std::string title;
-    std::string artist;
-    std::string album;
-    int lengthSeconds; // optional, can compute separately
-};
-
 class Mp3Reader {
 public:
-    static Mp3Metadata read(const std::string& filename);
+    // ID3v2 (v2.3 and v2.4) with an ID3v1 fallback
+    static TrackMetadata read(const std::string& filename,
+                              unsigned fields = TrackMetadata::AllFields);
+    // From an open file, positioned at its start
+    static TrackMetadata read(std::istream& file, unsigned fields);
+    // Starts with an ID3v2 tag or an MPEG frame
+    static bool sniff(const char* head, size_t length);
+
+    // Size of the ID3v1 block at the end of the file
+    static constexpr size_t kTailSize = 128;
+
+    // Bytes from the start of the file that hold the whole ID3v2 tag, given
+    // at least its first 10 bytes (10 when there is no tag)
+    static size_t headSize(const char* header, size_t length);
+
+    // The parsing steps on their own, so callers can do the I/O however they
+    // like. parseHead reads the ID3v2 tag from the start of the file (a
+    // prefix of it is fine) and returns the wanted fields it found;
+    // parseTail fills wanted fields still missing from the file's last
+    // kTailSize bytes (ID3v1), which are only worth reading if wantsTail.
+    static unsigned parseHead(const char* head, size_t headLength, unsigned fields, TrackMetadata& meta);
+    static bool wantsTail(unsigned fields, unsigned found);
+    static void parseTail(const char* tail, unsigned fields, unsigned found, TrackMetadata& meta);
+
+    // Where the audio starts: after the ID3v2 tag (and its footer), or 0
+    // when the file has none. Needs the first 10 bytes.
+    static size_t audioStart(const char* header, size_t length);
+    // Bytes from audioStart() that estimateLength() looks at
+    static constexpr size_t kFrameProbeSize = 4096;
+    // Length in seconds from the first MPEG audio frame, for files without
+    // a TLEN frame: the frame count of a Xing / Info or VBRI header when the
+    // encoder wrote one, else the bitrate over audioBytes (exact for CBR).
+    // frames starts at audioStart(); audioBytes runs from there to the end
+    // of the file. 0 when no frame is found.
+    static int estimateLength(const char* frames, size_t length, uint64_t audioBytes);
+
+    // Both of the above; tail may be null
+    static TrackMetadata parse(const char* head, size_t headLength, const char* tail,
+                               unsigned fields = TrackMetadata::AllFields);
 };
 
 #endif // MP3READER_H
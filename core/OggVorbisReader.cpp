@@ -0,0 +1,120 @@
+#include "OggVorbisReader.h"
+#include "TagText.h"
+#include "VorbisComment.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr size_t kPageHeader = 27;
+// Header plus a full segment table plus 255 full segments
+constexpr size_t kMaxPage = kPageHeader + 255 + 255 * 255;
+
+// Granule position of the last page of the stream that ends a packet; for
+// Vorbis that is the number of samples decoded up to there. -1 if there is
+// none in reach.
+int64_t lastGranule(std::istream& file, uint32_t serial)
+{
+    file.clear();
+    file.seekg(0, std::ios::end);
+    const std::streamoff size = file.tellg();
+    if (size < std::streamoff(kPageHeader))
+        return -1;
+
+    // The last page starts within the last kMaxPage bytes
+    const size_t chunk = size_t(std::min<std::streamoff>(size, kMaxPage));
+    std::vector<char> tail(chunk);
+    file.seekg(size - std::streamoff(chunk));
+    if (!file.read(tail.data(), std::streamsize(chunk)))
+        return -1;
+
+    for (size_t at = chunk - kPageHeader + 1; at-- > 0;) {
+        const char* page = tail.data() + at;
+        if (std::memcmp(page, "OggS", 4) != 0 || page[4] != 0 || littleEndian32(page + 14) != serial)
+            continue;
+        int64_t granule = int64_t(littleEndian64(page + 6));
+        if (granule >= 0)
+            return granule;
+    }
+    return -1;
+}
+
+}
+
+bool OggVorbisReader::sniff(const char* head, size_t length)
+{
+    return length >= 4 && std::memcmp(head, "OggS", 4) == 0;
+}
+
+TrackMetadata OggVorbisReader::read(std::istream& file, unsigned fields)
+{
+    TrackMetadata meta;
+    const bool needComment = fields & ~TrackMetadata::Length;
+
+    // Pages of the first logical stream, reassembled into packets until
+    // the comment header (packet 1) is complete
+    uint32_t serial = 0;
+    bool haveSerial = false;
+    uint32_t sampleRate = 0;
+    std::vector<char> packet;
+    int packetIndex = 0;
+    bool done = false;
+    while (!done) {
+        char header[kPageHeader];
+        if (!file.read(header, kPageHeader) || std::memcmp(header, "OggS", 4) != 0)
+            break;
+        const uint32_t pageSerial = littleEndian32(header + 14);
+        const unsigned segments = (unsigned char)header[26];
+        unsigned char lacing[255];
+        if (!file.read(reinterpret_cast<char*>(lacing), segments))
+            break;
+        size_t bodySize = 0;
+        for (unsigned i = 0; i < segments; ++i)
+            bodySize += lacing[i];
+
+        if (!haveSerial) {
+            serial = pageSerial;
+            haveSerial = true;
+        }
+        if (pageSerial != serial) {
+            file.seekg(std::streamoff(bodySize), std::ios::cur);
+            continue;
+        }
+
+        std::vector<char> body(bodySize);
+        if (!file.read(body.data(), std::streamsize(bodySize)))
+            break;
+
+        size_t offset = 0;
+        for (unsigned i = 0; i < segments && !done; ++i) {
+            packet.insert(packet.end(), body.data() + offset, body.data() + offset + lacing[i]);
+            offset += lacing[i];
+            if (lacing[i] == 255)
+                continue; // the packet goes on in the next segment
+
+            if (packetIndex == 0) {
+                // Identification header: "\x01vorbis", version, channels, rate
+                if (packet.size() < 16 || std::memcmp(packet.data(), "\x01vorbis", 7) != 0)
+                    return meta;
+                sampleRate = littleEndian32(packet.data() + 12);
+                done = !needComment;
+            } else {
+                if (packet.size() >= 7 && std::memcmp(packet.data(), "\x03vorbis", 7) == 0)
+                    parseVorbisComment(packet.data() + 7, packet.size() - 7, fields, meta);
+                done = true;
+            }
+            packet.clear();
+            ++packetIndex;
+        }
+    }
+
+    if ((fields & TrackMetadata::Length) && sampleRate) {
+        int64_t samples = lastGranule(file, serial);
+        if (samples > 0)
+            meta.lengthSeconds = int(samples / sampleRate);
+    }
+    return meta;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "TrackMetadata.h"
+
+#include <cstddef>
+#include <istream>
+
+// Native Ogg Vorbis: tags from the comment header, which follows the
+// identification header in the first pages, and the length from the
+// granule position of the last page, found by reading back from the end
+// of the file only when the length is wanted. The audio in between is
+// never read.
+class OggVorbisReader {
+public:
+    static bool sniff(const char* head, size_t length);
+    // file is positioned at its start
+    static TrackMetadata read(std::istream& file, unsigned fields);
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Immutable sequence with value semantics: copying is O(1) and an edit
+// never affects other copies. Elements live in a B-tree of shared,
+// read-only nodes with per-child counts; an edit copies only the nodes on
+// the path to the element (O(log n)) and shares everything else, so old
+// versions are cheap to keep around as undo snapshots and safe to read
+// from other threads while this copy moves on.
+//
+// Removals may leave nodes underfull (they are never merged); a bulk
+// rebuild from a range packs them again.
+template <typename T>
+class PersistentVector {
+public:
+    PersistentVector() = default;
+
+    template <typename It>
+    PersistentVector(It first, It last) { build(first, last); }
+
+    size_t size() const { return root ? root->total : 0; }
+    bool empty() const { return size() == 0; }
+
+    // O(log n); index must be < size()
+    const T& operator[](size_t index) const
+    {
+        const Node* node = root.get();
+        while (!node->leaf) {
+            size_t child = node->childFor(index);
+            if (child > 0)
+                index -= node->counts[child - 1];
+            node = node->children[child].get();
+        }
+        return node->values[index];
+    }
+
+    void push_back(T value)
+    {
+        if (!root) {
+            auto leaf = std::make_shared<Node>(true);
+            leaf->values.push_back(std::move(value));
+            leaf->total = 1;
+            root = std::move(leaf);
+            return;
+        }
+
+        if (NodePtr sibling = append(root, std::move(value))) {
+            auto parent = std::make_shared<Node>(false);
+            parent->children = { root, std::move(sibling) };
+            parent->recount(0);
+            root = std::move(parent);
+        }
+    }
+
+    // Replaces one element; index must be < size()
+    void set(size_t index, T value)
+    {
+        replace(root, index, std::move(value));
+    }
+
+    // index must be < size()
+    void erase(size_t index)
+    {
+        if (!remove(root, index))
+            root.reset();
+        // Drop levels left with a single child
+        while (root && !root->leaf && root->children.size() == 1)
+            root = root->children.front();
+    }
+
+    // In-order visit, much cheaper than indexing every element
+    template <typename F>
+    void forEach(F&& visit) const
+    {
+        if (root)
+            walk(*root, visit);
+    }
+
+    template <typename It>
+    void assign(It first, It last)
+    {
+        root.reset();
+        build(first, last);
+    }
+
+private:
+    static constexpr size_t kLeafSize = 32;
+    static constexpr size_t kBranching = 32;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        explicit Node(bool leaf) : leaf(leaf) {}
+
+        bool leaf;
+        size_t total = 0;
+        std::vector<T> values;          // leaf
+        std::vector<NodePtr> children;  // inner
+        std::vector<size_t> counts;     // inner: running element count per child
+
+        size_t childFor(size_t index) const
+        {
+            return size_t(std::upper_bound(counts.begin(), counts.end(), index) - counts.begin());
+        }
+
+        void recount(size_t from)
+        {
+            counts.resize(children.size());
+            size_t running = from > 0 ? counts[from - 1] : 0;
+            for (size_t i = from; i < children.size(); ++i) {
+                running += children[i]->total;
+                counts[i] = running;
+            }
+            total = running;
+        }
+    };
+
+    // Nodes nobody else references are edited in place; shared ones (still
+    // part of another version) are copied first. A run of edits with no
+    // copy taken in between therefore only copies each path once.
+    static Node& own(NodePtr& node)
+    {
+        if (node.use_count() != 1)
+            node = std::make_shared<Node>(*node);
+        return const_cast<Node&>(*node);
+    }
+
+    // Appends to the rightmost leaf under node. When that subtree is full
+    // the value goes into a new subtree of the same height, which is
+    // returned for the caller to link in.
+    static NodePtr append(NodePtr& node, T&& value)
+    {
+        if (node->leaf) {
+            if (node->values.size() < kLeafSize) {
+                Node& leaf = own(node);
+                leaf.values.push_back(std::move(value));
+                leaf.total++;
+                return nullptr;
+            }
+            auto fresh = std::make_shared<Node>(true);
+            fresh->values.push_back(std::move(value));
+            fresh->total = 1;
+            return fresh;
+        }
+
+        Node& inner = own(node);
+        const size_t changedFrom = inner.children.size() - 1;
+        NodePtr childSibling = append(inner.children.back(), std::move(value));
+        if (childSibling && inner.children.size() == kBranching) {
+            auto fresh = std::make_shared<Node>(false);
+            fresh->children.push_back(std::move(childSibling));
+            fresh->recount(0);
+            inner.recount(changedFrom);
+            return fresh;
+        }
+        if (childSibling)
+            inner.children.push_back(std::move(childSibling));
+        inner.recount(changedFrom);
+        return nullptr;
+    }
+
+    static void replace(NodePtr& node, size_t index, T&& value)
+    {
+        Node& owned = own(node);
+        if (owned.leaf) {
+            owned.values[index] = std::move(value);
+            return;
+        }
+        size_t child = owned.childFor(index);
+        if (child > 0)
+            index -= owned.counts[child - 1];
+        replace(owned.children[child], index, std::move(value));
+    }
+
+    // Removes element index under node; false when the subtree would be
+    // left empty (the caller drops it instead)
+    static bool remove(NodePtr& node, size_t index)
+    {
+        if (node->leaf) {
+            if (node->values.size() == 1)
+                return false;
+            Node& leaf = own(node);
+            leaf.values.erase(leaf.values.begin() + index);
+            leaf.total--;
+            return true;
+        }
+
+        size_t child = node->childFor(index);
+        if (child > 0)
+            index -= node->counts[child - 1];
+        if (node->children.size() == 1 && node->children[child]->total == 1)
+            return false;
+
+        Node& inner = own(node);
+        if (!remove(inner.children[child], index))
+            inner.children.erase(inner.children.begin() + child);
+        inner.recount(child);
+        return true;
+    }
+
+    template <typename F>
+    static void walk(const Node& node, F& visit)
+    {
+        if (node.leaf) {
+            for (const T& value : node.values)
+                visit(value);
+            return;
+        }
+        for (const NodePtr& child : node.children)
+            walk(*child, visit);
+    }
+
+    // Packs full leaves, then full levels of inner nodes above them
+    template <typename It>
+    void build(It first, It last)
+    {
+        std::vector<NodePtr> level;
+        while (first != last) {
+            auto leaf = std::make_shared<Node>(true);
+            leaf->values.reserve(kLeafSize);
+            while (first != last && leaf->values.size() < kLeafSize)
+                leaf->values.push_back(*first++);
+            leaf->total = leaf->values.size();
+            level.push_back(std::move(leaf));
+        }
+
+        while (level.size() > 1) {
+            std::vector<NodePtr> parents;
+            for (size_t i = 0; i < level.size(); i += kBranching) {
+                auto parent = std::make_shared<Node>(false);
+                size_t end = std::min(level.size(), i + kBranching);
+                parent->children.assign(level.begin() + i, level.begin() + end);
+                parent->recount(0);
+                parents.push_back(std::move(parent));
+            }
+            level.swap(parents);
+        }
+
+        root = level.empty() ? nullptr : std::move(level.front());
+    }
+
+    NodePtr root;
+};
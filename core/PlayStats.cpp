@@ -0,0 +1,473 @@
+#include "PlayStats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout, integers little-endian:
+//
+//   header   8-byte magic, u64 generation
+//   record   u32 size, u32 CRC-32 of the payload, then size payload bytes:
+//            u8 kind, i64 time, [u32 plays, u32 skips if Total], file name
+//
+// The log holds Play and Skip records, the snapshot Total records. A new
+// snapshot gets the next generation and the log is restarted with it, so
+// a log left over from before the last compaction is recognised and
+// ignored instead of being counted twice.
+
+namespace {
+
+constexpr char kLogMagic[8] = { 'P', 'L', 'A', 'Y', 'L', 'O', 'G', '1' };
+constexpr char kSnapshotMagic[8] = { 'P', 'L', 'A', 'Y', 'S', 'N', 'P', '1' };
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kRecordHead = 8;
+constexpr size_t kEventSize = 1 + 8;      // kind, time
+constexpr size_t kTotalSize = 1 + 8 + 8;  // kind, time, plays, skips
+
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+uint32_t crc32(const unsigned char* data, size_t length)
+{
+    static const CrcTable table;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i)
+        c = table.entries[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+void put32(std::string& out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(char(v >> (8 * i)));
+}
+
+void put64(std::string& out, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(char(v >> (8 * i)));
+}
+
+uint32_t get32(const unsigned char* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint64_t get64(const unsigned char* p)
+{
+    return uint64_t(get32(p)) | uint64_t(get32(p + 4)) << 32;
+}
+
+void putHeader(std::string& out, const char (&magic)[8], uint64_t generation)
+{
+    out.append(magic, sizeof(magic));
+    put64(out, generation);
+}
+
+// Size and checksum are filled in once the payload is in place
+void putRecord(std::string& out, uint8_t kind, int64_t time, std::string_view filename,
+               const PlayStats::Entry* total)
+{
+    const size_t start = out.size();
+    out.append(kRecordHead, '\0');
+    out.push_back(char(kind));
+    put64(out, uint64_t(time));
+    if (total) {
+        put32(out, total->plays);
+        put32(out, total->skips);
+    }
+    out += filename;
+
+    const size_t size = out.size() - start - kRecordHead;
+    std::string head;
+    put32(head, uint32_t(size));
+    put32(head, crc32(reinterpret_cast<const unsigned char*>(out.data()) + start + kRecordHead, size));
+    out.replace(start, kRecordHead, head);
+}
+
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+bool writeAll(int fd, const std::string& data)
+{
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += size_t(n);
+    }
+    return true;
+}
+#endif
+
+}
+
+PlayStats::PlayStats(Config config)
+    : config(config)
+{
+    size_t capacity = 1;
+    while (capacity < config.queueSlots)
+        capacity <<= 1;
+    slots.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; ++i)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    slotMask = capacity - 1;
+}
+
+PlayStats::~PlayStats()
+{
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+#ifdef __linux__
+    if (logFd >= 0)
+        close(logFd);
+#endif
+}
+
+std::string PlayStats::defaultDirectory()
+{
+    if (const char* data = std::getenv("XDG_DATA_HOME"); data && *data)
+        return std::string(data) + "/player";
+    if (const char* home = std::getenv("HOME"); home && *home)
+        return std::string(home) + "/.local/share/player";
+    return ".player";
+}
+
+void PlayStats::played(std::string_view filename)
+{
+    record(Kind::Play, filename);
+}
+
+void PlayStats::skipped(std::string_view filename)
+{
+    record(Kind::Skip, filename);
+}
+
+void PlayStats::record(Kind kind, std::string_view filename)
+{
+    if (!accepting.load(std::memory_order_relaxed))
+        return;
+    if (filename.size() > kMaxFilename) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t position = head.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[position & slotMask];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (sequence < position) {
+            // Still holds the event from one lap ago: the writer is behind
+            droppedEvents.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+    slot->kind = kind;
+    slot->time = now();
+    slot->length = filename.size();
+    std::memcpy(slot->filename, filename.data(), filename.size());
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+PlayStats::Entry PlayStats::lookup(const std::string& filename) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(filename);
+    return it == entries.end() ? Entry() : it->second;
+}
+
+void PlayStats::restore(const PlaylistImpl& playlist, size_t first, size_t end) const
+{
+    TrackStore& store = *playlist.trackStore();
+    size_t index = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.empty())
+        return;
+    playlist.snapshot().forEach([&](const PlaylistImpl::Entry& e) {
+        if (index >= first && index < end) {
+            auto it = entries.find(e.track->filename);
+            if (it != entries.end())
+                store.setCounts(e.id, it->second.plays, it->second.skips);
+        }
+        ++index;
+    });
+}
+
+void PlayStats::apply(Kind kind, int64_t time, const std::string& filename, const Entry* total)
+{
+    Entry& entry = entries[filename];
+    switch (kind) {
+    case Kind::Play:
+        entry.plays++;
+        entry.lastPlayed = std::max(entry.lastPlayed, time);
+        break;
+    case Kind::Skip:
+        entry.skips++;
+        break;
+    case Kind::Total:
+        entry = *total;
+        break;
+    }
+}
+
+void PlayStats::run()
+{
+    for (;;) {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, config.flushInterval, [this] { return stopping; });
+            stop = stopping;
+        }
+        flush();
+        if (logBytes >= std::max(config.compactBytes, snapshotBytes))
+            compact();
+        if (stop)
+            return;
+    }
+}
+
+#ifdef __linux__
+
+bool PlayStats::open(const std::string& directory, std::string& error)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        error = directory + ": " + ec.message();
+        return false;
+    }
+    snapshotPath = directory + "/plays.snapshot";
+    logPath = directory + "/plays.log";
+
+    // lookup() and restore() may already be asking from another thread
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t snapshotGeneration = 0;
+    if (!load(snapshotPath, true, snapshotGeneration, snapshotBytes)) {
+        error = snapshotPath + ": not a play statistics file";
+        return false;
+    }
+    uint64_t logGeneration = snapshotGeneration;
+    uint64_t logValid = 0;
+    if (!load(logPath, false, logGeneration, logValid)) {
+        error = logPath + ": not a play statistics file";
+        return false;
+    }
+    generation = snapshotGeneration;
+
+    if (!openLog(logValid < kHeaderSize, logValid)) {
+        error = logPath + ": " + std::strerror(errno);
+        return false;
+    }
+    accepting = true;
+    worker = std::thread(&PlayStats::run, this);
+    return true;
+}
+
+// For the log, fileGeneration passes in the generation it must have; a
+// log from another one is left out and reported as empty
+bool PlayStats::load(const std::string& path, bool snapshot, uint64_t& fileGeneration, uint64_t& validBytes)
+{
+    validBytes = 0;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno == ENOENT;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < kHeaderSize) {
+        close(fd);
+        return true; // torn before the header was written: nothing in it
+    }
+    const size_t size = size_t(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    const unsigned char* data = static_cast<const unsigned char*>(mapped);
+
+    const char* magic = snapshot ? kSnapshotMagic : kLogMagic;
+    if (std::memcmp(data, magic, sizeof(kLogMagic)) != 0) {
+        munmap(mapped, size);
+        return false;
+    }
+    const uint64_t found = get64(data + 8);
+    if (!snapshot && found != fileGeneration) {
+        munmap(mapped, size);
+        return true;
+    }
+    fileGeneration = found;
+
+    std::string filename;
+    size_t offset = kHeaderSize;
+    while (offset + kRecordHead <= size) {
+        const size_t length = get32(data + offset);
+        const unsigned char* payload = data + offset + kRecordHead;
+        const size_t minimum = snapshot ? kTotalSize : kEventSize;
+        if (length < minimum || length > size - offset - kRecordHead)
+            break;
+        if (crc32(payload, length) != get32(data + offset + 4))
+            break;
+        const Kind kind = Kind(payload[0]);
+        if (snapshot ? kind != Kind::Total : kind != Kind::Play && kind != Kind::Skip)
+            break;
+
+        Entry total;
+        if (snapshot) {
+            total.lastPlayed = int64_t(get64(payload + 1));
+            total.plays = get32(payload + 9);
+            total.skips = get32(payload + 13);
+        }
+        filename.assign(reinterpret_cast<const char*>(payload) + minimum, length - minimum);
+        apply(kind, int64_t(get64(payload + 1)), filename, snapshot ? &total : nullptr);
+        offset += kRecordHead + length;
+    }
+    validBytes = offset;
+    munmap(mapped, size);
+    return true;
+}
+
+// Starts an empty log of the current generation, or appends to the one
+// there after cutting off a torn last record
+bool PlayStats::openLog(bool fresh, uint64_t validBytes)
+{
+    if (logFd >= 0)
+        close(logFd);
+    logFd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (logFd < 0)
+        return false;
+
+    if (!fresh) {
+        logBytes = validBytes;
+        return ftruncate(logFd, off_t(validBytes)) == 0;
+    }
+    std::string header;
+    putHeader(header, kLogMagic, generation);
+    logBytes = header.size();
+    return ftruncate(logFd, 0) == 0 && writeAll(logFd, header) && fdatasync(logFd) == 0;
+}
+
+void PlayStats::flush()
+{
+    std::string buffer;
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Stops at the first slot not filled yet; a producer still copying
+        // into it is picked up next time
+        for (;;) {
+            Slot& slot = slots[tail & slotMask];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+                break;
+            filename.assign(slot.filename, slot.length);
+            putRecord(buffer, uint8_t(slot.kind), slot.time, filename, nullptr);
+            apply(slot.kind, slot.time, filename, nullptr);
+            slot.sequence.store(tail + slotMask + 1, std::memory_order_release);
+            ++tail;
+        }
+    }
+    if (buffer.empty())
+        return;
+
+    // One write and one sync per batch. On failure the counts in memory
+    // stand and the log keeps what made it.
+    if (logFd >= 0 && writeAll(logFd, buffer)) {
+        fdatasync(logFd);
+        logBytes += buffer.size();
+    }
+}
+
+bool PlayStats::compact()
+{
+    // entries only changes on this thread, so it is read without the lock
+    const std::string temporary = snapshotPath + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    std::string buffer;
+    putHeader(buffer, kSnapshotMagic, generation + 1);
+    uint64_t written = 0;
+    bool ok = true;
+    for (const auto& [filename, entry] : entries) {
+        putRecord(buffer, uint8_t(Kind::Total), entry.lastPlayed, filename, &entry);
+        if (buffer.size() >= (1u << 20)) {
+            ok = ok && writeAll(fd, buffer);
+            written += buffer.size();
+            buffer.clear();
+        }
+    }
+    ok = ok && writeAll(fd, buffer) && fsync(fd) == 0;
+    written += buffer.size();
+    close(fd);
+    if (!ok || rename(temporary.c_str(), snapshotPath.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    // The rename must be durable before the log it replaces is emptied
+    const std::string directory = snapshotPath.substr(0, snapshotPath.find_last_of('/'));
+    int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+
+    generation++;
+    snapshotBytes = written;
+    return openLog(true, 0);
+}
+
+#else
+
+bool PlayStats::open(const std::string&, std::string& error)
+{
+    error = "play statistics are only kept on Linux";
+    return false;
+}
+
+bool PlayStats::load(const std::string&, bool, uint64_t&, uint64_t&) { return false; }
+bool PlayStats::openLog(bool, uint64_t) { return false; }
+void PlayStats::flush() {}
+bool PlayStats::compact() { return false; }
+
+#endif
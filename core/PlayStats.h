@@ -0,0 +1,122 @@
+#pragma once
+
+#include "PlaylistImpl.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+// Play counts, skip counts and the last time each file was played, kept
+// across sessions. Files are identified by path, since track ids are only
+// good for one run.
+//
+// On disk the statistics are a snapshot plus an append-only log of the
+// events since, both made of checksummed records. Recording an event
+// copies it into a slot of a ring allocated up front and returns; a
+// writer thread appends what has piled up once per flush interval and
+// syncs it in one go. An event that finds the ring full, or whose path
+// does not fit a slot, is dropped and counted. When the log outgrows the
+// snapshot the writer folds it into a new snapshot and starts an empty
+// log. A crash loses at most the last interval, and a record torn by it
+// is dropped on the next load along with anything after.
+//
+// Both files are mapped and read in one pass at open(). Needs Linux; on
+// other platforms open() fails and events are dropped.
+class PlayStats {
+public:
+    struct Config {
+        std::chrono::milliseconds flushInterval{1000}; // longest an event waits for the disk
+        uint64_t compactBytes = 1ull << 20;            // smallest log worth compacting
+        size_t queueSlots = 256;                       // events one interval holds, rounded up to a power of 2
+    };
+
+    struct Entry {
+        uint32_t plays = 0;
+        uint32_t skips = 0;
+        int64_t lastPlayed = 0; // seconds since the epoch, 0 for never
+    };
+
+    PlayStats() : PlayStats(Config()) {}
+    explicit PlayStats(Config config);
+    // Writes the events still queued
+    ~PlayStats();
+
+    PlayStats(const PlayStats&) = delete;
+    PlayStats& operator=(const PlayStats&) = delete;
+
+    // $XDG_DATA_HOME/player, else ~/.local/share/player
+    static std::string defaultDirectory();
+
+    // Loads the statistics kept in directory (created if missing) and
+    // starts writing there. Call once, before the first event.
+    bool open(const std::string& directory, std::string& error);
+
+    // Any thread; lock-free and does not allocate
+    void played(std::string_view filename);
+    void skipped(std::string_view filename);
+    // Events lost to a full queue or an over-long path
+    uint64_t dropped() const { return droppedEvents.load(std::memory_order_relaxed); }
+
+    // As written so far; events still queued are not counted yet
+    Entry lookup(const std::string& filename) const;
+    // Copies the counts of rows [first, end) of playlist into its track
+    // store, e.g. after adding them. Walks the whole playlist once; for a
+    // single track lookup() is cheaper.
+    void restore(const PlaylistImpl& playlist, size_t first, size_t end) const;
+
+private:
+    enum class Kind : uint8_t { Play = 1, Skip = 2, Total = 3 };
+
+    static constexpr size_t kMaxFilename = 1024;
+
+    // Free while sequence equals the position that claims it next, filled
+    // once it is one past that
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        Kind kind;
+        int64_t time;
+        size_t length;
+        char filename[kMaxFilename];
+    };
+
+    void record(Kind kind, std::string_view filename);
+    void run();
+    // Appends the queued events to the log and syncs it
+    void flush();
+    bool compact();
+    bool load(const std::string& path, bool snapshot, uint64_t& fileGeneration, uint64_t& validBytes);
+    bool openLog(bool fresh, uint64_t validBytes);
+    void apply(Kind kind, int64_t time, const std::string& filename, const Entry* total);
+
+    const Config config;
+    std::string logPath;
+    std::string snapshotPath;
+    int logFd = -1;
+    uint64_t logBytes = 0;
+    uint64_t snapshotBytes = 0;
+    uint64_t generation = 0;
+
+    // Claimed by any thread at head, taken in order by the writer at tail
+    std::unique_ptr<Slot[]> slots;
+    size_t slotMask = 0;
+    std::atomic<size_t> head{0};
+    size_t tail = 0;
+    std::atomic<uint64_t> droppedEvents{0};
+    std::atomic<bool> accepting{false}; // open() succeeded
+
+    // Written only by the writer thread (and open() before it starts);
+    // readers on other threads hold the mutex
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread worker;
+};
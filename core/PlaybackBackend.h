@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// What the frontends need from an audio engine: open a file and play it,
+// pause, seek, and say when the track has ended. QMediaPlayer (GUI),
+// libVLC (CLI and daemon) and a simulated engine for benchmarks implement
+// it. The rules about what plays next live in PlaybackController.
+//
+// Events are delivered on the thread that drives the backend: the Qt event
+// loop, VlcBackend::poll(), or SimulatedBackend::advance(). A handler may
+// call back into the backend, e.g. load the next track from endOfTrack.
+class PlaybackBackend {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State { Stopped, Buffering, Playing, Paused, Error };
+
+    struct Events {
+        std::function<void(State)> stateChanged;
+        std::function<void(int64_t ms)> durationChanged;
+        // Only from backends that get position ticks for free; otherwise
+        // ask position() when needed
+        std::function<void(int64_t ms)> positionChanged;
+        // Played to the end (not stopped or replaced)
+        std::function<void()> endOfTrack;
+    };
+
+    virtual ~PlaybackBackend() = default;
+
+    void setEvents(Events handlers) { events = std::move(handlers); }
+
+    // Replaces whatever was loaded and starts playing it
+    virtual void load(const std::string& filename) = 0;
+    // Resumes after pause()
+    virtual void play() = 0;
+    virtual void pause() = 0;
+    virtual void stop() = 0;
+    virtual void seek(int64_t ms) = 0;
+
+    virtual State state() const = 0;
+    virtual int64_t position() const = 0; // ms
+    virtual int64_t duration() const = 0; // ms, 0 while unknown
+
+    // The backend's idea of the current time: the real clock, except in
+    // simulation
+    virtual Clock::time_point now() const { return Clock::now(); }
+
+protected:
+    void emitState(State state) { if (events.stateChanged) events.stateChanged(state); }
+    void emitDuration(int64_t ms) { if (events.durationChanged) events.durationChanged(ms); }
+    void emitPosition(int64_t ms) { if (events.positionChanged) events.positionChanged(ms); }
+    void emitEndOfTrack() { if (events.endOfTrack) events.endOfTrack(); }
+
+private:
+    Events events;
+};
@@ -0,0 +1,133 @@
+#include "PlaybackController.h"
+#include "PlayStats.h"
+#include "Prefetcher.h"
+
+PlaybackController::PlaybackController(PlaybackBackend& backend, Prefetcher* prefetcher)
+    : player(backend),
+    prefetcher(prefetcher)
+{
+    PlaybackBackend::Events events;
+    events.stateChanged = [this](PlaybackBackend::State state) { stateChanged(state); };
+    events.durationChanged = [this](int64_t ms) {
+        if (on.durationChanged)
+            on.durationChanged(ms);
+    };
+    events.positionChanged = [this](int64_t ms) {
+        if (on.positionChanged)
+            on.positionChanged(ms);
+    };
+    events.endOfTrack = [this]() { endOfTrack(); };
+    player.setEvents(std::move(events));
+}
+
+bool PlaybackController::play(size_t index)
+{
+    if (!list || index >= list->size())
+        return false;
+    if (int(index) != list->currentIndex())
+        skipCurrent(list->currentIndex());
+    list->setCurrent(index);
+    return start(index);
+}
+
+void PlaybackController::resume()
+{
+    if (player.state() == PlaybackBackend::State::Paused)
+        player.play();
+    else if (list && list->currentIndex() >= 0)
+        start(size_t(list->currentIndex()));
+}
+
+void PlaybackController::pause()
+{
+    player.pause();
+}
+
+void PlaybackController::stop()
+{
+    starting = false;
+    player.stop();
+}
+
+bool PlaybackController::next()
+{
+    return step(true, true);
+}
+
+bool PlaybackController::prev()
+{
+    return step(false, true);
+}
+
+bool PlaybackController::step(bool forward, bool skipping)
+{
+    if (!list || list->empty())
+        return false;
+    int before = list->currentIndex();
+    forward ? list->next() : list->prev();
+    int after = list->currentIndex();
+    // next()/prev() park on the last/first track when repeat is off
+    if (after == before && list->getRepeatMode() == PlaylistImpl::RepeatMode::Off)
+        return false;
+    if (skipping)
+        skipCurrent(before);
+    return start(size_t(after));
+}
+
+bool PlaybackController::start(size_t index)
+{
+    Track track = list->at(index);
+    if (track.filename.empty())
+        return false;
+
+    current = std::move(track);
+    requested = player.now();
+    starting = true;
+
+    if (prefetcher)
+        prefetcher->trackStarted(current.filename);
+    player.load(current.filename);
+    if (prefetcher)
+        prefetcher->follow(*list);
+    list->trackStore()->countPlay(list->idAt(index));
+    if (playStats)
+        playStats->played(current.filename);
+
+    if (on.trackStarted)
+        on.trackStarted(index, current);
+    return true;
+}
+
+// A next / previous / play that leaves the track before it ended.
+// index is where it sat in the list, if it still does.
+void PlaybackController::skipCurrent(int index)
+{
+    const PlaybackBackend::State state = player.state();
+    if (current.filename.empty() || !(starting || state == PlaybackBackend::State::Playing
+                                      || state == PlaybackBackend::State::Paused))
+        return;
+    if (index >= 0 && list->at(size_t(index)).filename == current.filename)
+        list->trackStore()->countSkip(list->idAt(size_t(index)));
+    if (playStats)
+        playStats->skipped(current.filename);
+}
+
+void PlaybackController::stateChanged(PlaybackBackend::State state)
+{
+    if (state == PlaybackBackend::State::Playing && starting) {
+        starting = false;
+        Clock::duration latency = player.now() - requested;
+        counters.transitions++;
+        counters.totalLatency += latency;
+        if (latency > counters.maxLatency)
+            counters.maxLatency = latency;
+    }
+    if (on.stateChanged)
+        on.stateChanged(state);
+}
+
+void PlaybackController::endOfTrack()
+{
+    if (!step(true, false) && on.finished)
+        on.finished();
+}
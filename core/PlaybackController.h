@@ -0,0 +1,93 @@
+#pragma once
+
+#include "PlaybackBackend.h"
+#include "PlaylistImpl.h"
+
+#include <cstdint>
+#include <functional>
+
+class PlayStats;
+class Prefetcher;
+
+// The playback rules every frontend shares, on top of a PlaybackBackend:
+//
+//  - a track that ends is followed by the next one in playback order
+//    (shuffle included); with repeat off playback stops after the last
+//    one, with repeat one the same track starts over
+//  - next / previous step through the same order and only wrap around
+//    with repeat all
+//  - every track start counts as a play and moves the prefetcher along;
+//    leaving a track for another before it ends counts as a skip
+//
+// One playlist is played at a time. Pointing the controller at another
+// playlist leaves the playing track alone; what follows it comes from the
+// new playlist.
+class PlaybackController {
+public:
+    using Clock = PlaybackBackend::Clock;
+
+    // Track starts that reached Playing and how long each took from the
+    // request (a skip, or the previous track ending), in the backend's time
+    struct Stats {
+        uint64_t transitions = 0;
+        Clock::duration totalLatency{};
+        Clock::duration maxLatency{};
+    };
+
+    // Called on the thread that drives the backend
+    struct Hooks {
+        std::function<void(size_t index, const Track& track)> trackStarted;
+        // The last track ended and nothing follows it
+        std::function<void()> finished;
+        // Passed through from the backend
+        std::function<void(PlaybackBackend::State)> stateChanged;
+        std::function<void(int64_t ms)> durationChanged;
+        std::function<void(int64_t ms)> positionChanged;
+    };
+
+    // prefetcher may be null
+    explicit PlaybackController(PlaybackBackend& backend, Prefetcher* prefetcher = nullptr);
+
+    PlaybackController(const PlaybackController&) = delete;
+    PlaybackController& operator=(const PlaybackController&) = delete;
+
+    void setHooks(Hooks hooks) { on = std::move(hooks); }
+    void setPlaylist(PlaylistImpl* playlist) { list = playlist; }
+    // Also records plays and skips there; may be null
+    void setPlayStats(PlayStats* stats) { playStats = stats; }
+    PlaylistImpl* playlist() const { return list; }
+    PlaybackBackend& backend() const { return player; }
+
+    // Makes the track at index current and starts it; false when there is
+    // no such track
+    bool play(size_t index);
+    // Resumes when paused, else (re)starts the current track
+    void resume();
+    void pause();
+    void stop();
+    // False at either end of the list with repeat off (nothing changes)
+    bool next();
+    bool prev();
+
+    // The track started last; empty filename before the first
+    const Track& playing() const { return current; }
+    Stats stats() const { return counters; }
+
+private:
+    bool step(bool forward, bool skipping);
+    bool start(size_t index);
+    void skipCurrent(int index);
+    void stateChanged(PlaybackBackend::State state);
+    void endOfTrack();
+
+    PlaybackBackend& player;
+    Prefetcher* prefetcher;
+    PlayStats* playStats = nullptr;
+    PlaylistImpl* list = nullptr;
+    Hooks on;
+
+    Track current;
+    bool starting = false; // a start is waiting for Playing
+    Clock::time_point requested;
+    Stats counters;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 struct Track {
@@ -8,8 +9,14 @@ struct Track {
     std::string artist;
     std::string album;
     int lengthSeconds; // total seconds
+    int trackNumber = 0; // position on the album, 0 when unknown
+    int year = 0; // 0 when unknown
 };
 
+// Stable track identifier handed out by the TrackStore (unlike an index,
+// it survives removals and sorting)
+using TrackId = uint32_t;
+
 class Playlist {
 public:
     virtual ~Playlist() = default;
@@ -1,20 +1,107 @@
 #include "PlaylistImpl.h"
+#include "MemoryStats.h"
 
 #include <numeric>   // For std::iota
 #include <random>    // For std::mt19937
 #include <algorithm> // For std::shuffle
 
 PlaylistImpl::PlaylistImpl()
-    : current(-1),
+    : PlaylistImpl(std::make_shared<TrackStore>())
+{
+}
+
+PlaylistImpl::PlaylistImpl(std::shared_ptr<TrackStore> store)
+    : store(std::move(store)),
+    current(-1),
     isShuffled(false),
     repeatMode(RepeatMode::Off)
 {
 }
 
-void PlaylistImpl::add(const Track& track)
+PlaylistImpl::PlaylistImpl(const PlaylistImpl& source)
+    : store(source.store),
+    entries(source.entries),
+    groupIndex(source.groupIndex),
+    positions(source.positions),
+    positionsDirty(source.positionsDirty),
+    playbackOrder(source.playbackOrder),
+    current(source.current),
+    isShuffled(source.isShuffled),
+    repeatMode(source.repeatMode)
+{
+    held.reserve(entries.size());
+    entries.forEach([this](const Entry& e) {
+        store->retain(e.id);
+        held.push_back(e.id);
+    });
+}
+
+PlaylistImpl::PlaylistImpl(const PlaylistImpl& source, std::vector<size_t> indices)
+    : PlaylistImpl(source.store, idsAt(source, std::move(indices)))
 {
-    tracks.push_back(track);
+}
+
+PlaylistImpl::PlaylistImpl(std::shared_ptr<TrackStore> tracks, const std::vector<TrackId>& ids)
+    : PlaylistImpl(std::move(tracks))
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    std::vector<Entry> picked;
+    picked.reserve(ids.size());
+    held.reserve(ids.size());
+    for (TrackId id : ids) {
+        const std::shared_ptr<const Track>& track = store->get(id);
+        store->retain(id);
+        held.push_back(id);
+        groupIndex.add(id, track->artist, track->album, track->lengthSeconds);
+        picked.push_back({ id, track });
+    }
+    entries.assign(picked.begin(), picked.end());
+    positionsDirty = true;
+
     rebuildPlaybackOrder();
+    if (!entries.empty())
+        current = 0;
+}
+
+std::vector<TrackId> PlaylistImpl::idsAt(const PlaylistImpl& source, std::vector<size_t> indices)
+{
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    while (!indices.empty() && indices.back() >= source.size())
+        indices.pop_back();
+
+    std::vector<TrackId> ids;
+    ids.reserve(indices.size());
+    for (size_t index : indices)
+        ids.push_back(source.entries[index].id);
+    return ids;
+}
+
+PlaylistImpl::~PlaylistImpl()
+{
+    for (TrackId id : held)
+        store->release(id);
+}
+
+void PlaylistImpl::add(const Track& track)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    // Consecutive adds share one undo step
+    if (!addsOpen) {
+        record(Edit::Add, 0);
+        addsOpen = true;
+    }
+    undoStack.back().where++;
+
+    const TrackId id = store->add(track);
+    held.push_back(id);
+    entries.push_back({ id, store->get(id) });
+    groupIndex.add(id, track.artist, track.album, track.lengthSeconds);
+    if (positions.size() <= id)
+        positions.resize(store->idLimit(), -1);
+    positions[id] = int(entries.size() - 1);
+    // Append to the existing order: O(1), and keeps a shuffled order intact
+    playbackOrder.push_back(entries.size() - 1);
 
     if (current == -1)
         current = 0;
@@ -22,12 +109,12 @@ void PlaylistImpl::add(const Track& track)
 
 Track PlaylistImpl::next()
 {
-    if (tracks.empty())
+    if (entries.empty())
         return {};
 
     if (repeatMode == RepeatMode::One) {
         // Keep the current track
-        return tracks[playbackOrder[current]];
+        return *entries[playbackOrder[current]].track;
     }
 
     current = (current + 1) % playbackOrder.size();
@@ -37,17 +124,17 @@ Track PlaylistImpl::next()
         current = playbackOrder.size() - 1; // keep last track
     }
 
-    return tracks[playbackOrder[current]];
+    return *entries[playbackOrder[current]].track;
 }
 
 Track PlaylistImpl::prev()
 {
-    if (tracks.empty())
+    if (entries.empty())
         return {};
 
     if (repeatMode == RepeatMode::One) {
         // Keep the current track
-        return tracks[playbackOrder[current]];
+        return *entries[playbackOrder[current]].track;
     }
 
     current--;
@@ -62,39 +149,95 @@ Track PlaylistImpl::prev()
         }
     }
 
-    return tracks[playbackOrder[current]];
+    return *entries[playbackOrder[current]].track;
 }
 
 bool PlaylistImpl::empty() const
 {
-    return tracks.empty();
+    return entries.empty();
 }
 
 Track PlaylistImpl::at(size_t index) const
 {
-    if (index >= tracks.size())
+    if (index >= entries.size())
         return {};
-    return tracks[index];
+    return *entries[index].track;
 }
 
 void PlaylistImpl::removeAt(size_t index)
 {
-    if (index >= tracks.size())
+    MemoryScope scope(MemoryTag::Playlist);
+    if (index >= entries.size())
         return;
 
-    tracks.erase(tracks.begin() + index);
+    record(Edit::Remove, index);
+    const TrackId id = entries[index].id;
+    entries.erase(index);
+    groupIndex.remove(id);
+    // Not patched in place: a playlist built from ids has no positions
+    // until the first indexOf()
+    positionsDirty = true;
+
+    // Drop the removed track from the playback order and close the gap
+    auto pos = std::find(playbackOrder.begin(), playbackOrder.end(), index);
+    if (pos != playbackOrder.end()) {
+        if (current > pos - playbackOrder.begin())
+            current--;
+        playbackOrder.erase(pos);
+    }
+    for (size_t& i : playbackOrder) {
+        if (i > index)
+            i--;
+    }
 
     // Adjust current index if needed
-    if (tracks.empty()) {
+    if (entries.empty()) {
         current = -1;
-    } else if (current >= tracks.size()) {
-        current = tracks.size() - 1;
+    } else if (current >= (int)entries.size()) {
+        current = entries.size() - 1;
+    }
+}
+
+std::vector<size_t> PlaylistImpl::upcoming(size_t count) const
+{
+    std::vector<size_t> result;
+    if (current < 0 || repeatMode == RepeatMode::One)
+        return result;
+
+    const size_t n = playbackOrder.size();
+    for (size_t step = 1; step <= count && step < n; ++step) {
+        size_t pos = size_t(current) + step;
+        if (pos >= n) {
+            if (repeatMode == RepeatMode::Off)
+                break;
+            pos -= n;
+        }
+        result.push_back(playbackOrder[pos]);
     }
+    return result;
+}
+
+void PlaylistImpl::setCurrent(size_t index)
+{
+    if (index >= entries.size())
+        return;
+
+    auto pos = std::find(playbackOrder.begin(), playbackOrder.end(), index);
+    if (pos != playbackOrder.end())
+        current = pos - playbackOrder.begin();
+}
+
+int PlaylistImpl::currentIndex() const
+{
+    if (current < 0 || current >= (int)playbackOrder.size())
+        return -1;
+    return (int)playbackOrder[current];
 }
 
 void PlaylistImpl::rebuildPlaybackOrder()
 {
-    playbackOrder.resize(tracks.size());
+    MemoryScope scope(MemoryTag::Playlist);
+    playbackOrder.resize(entries.size());
     std::iota(playbackOrder.begin(), playbackOrder.end(), 0);
 }
 
@@ -115,3 +258,254 @@ void PlaylistImpl::disableShuffle()
     rebuildPlaybackOrder();
     current = 0;
 }
+
+std::vector<size_t> PlaylistImpl::sortBy(const std::vector<SortKey>& order)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    std::vector<const Track*> tracks;
+    std::vector<const CollationKeys*> keys;
+    tracks.reserve(entries.size());
+    keys.reserve(entries.size());
+    entries.forEach([&](const Entry& e) {
+        tracks.push_back(e.track.get());
+        keys.push_back(&store->collation(e.id));
+    });
+
+    std::vector<size_t> perm = sortPermutation(tracks, keys, order);
+    applyPermutation(perm);
+    return perm;
+}
+
+void PlaylistImpl::applyPermutation(const std::vector<size_t>& order)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    if (order.size() != entries.size())
+        return;
+
+    record(Edit::Reorder, 0);
+
+    std::vector<size_t> newIndex(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        newIndex[order[i]] = i;
+
+    std::vector<Entry> flat;
+    flat.reserve(entries.size());
+    entries.forEach([&](const Entry& e) { flat.push_back(e); });
+    std::vector<Entry> reordered;
+    reordered.reserve(flat.size());
+    for (size_t from : order)
+        reordered.push_back(std::move(flat[from]));
+    entries.assign(reordered.begin(), reordered.end());
+    positionsDirty = true;
+
+    int playing = currentIndex();
+    if (isShuffled) {
+        // Same shuffled sequence of tracks, at their new indices
+        for (size_t& i : playbackOrder)
+            i = newIndex[i];
+    } else {
+        rebuildPlaybackOrder();
+        if (playing >= 0)
+            current = newIndex[playing];
+    }
+}
+
+void PlaylistImpl::record(Edit edit, size_t where)
+{
+    undoStack.push_back({ entries, edit, where, store->updates() });
+    redoStack.clear();
+    addsOpen = false;
+}
+
+// Tracks updated in the store since the snapshot was taken are swapped
+// for their new versions; the current list is kept up to date as they
+// change, but old snapshots are only patched here
+void PlaylistImpl::catchUp(Revision& revision) const
+{
+    if (revision.updates == store->updates())
+        return;
+
+    std::vector<size_t> stale;
+    size_t index = 0;
+    revision.state.forEach([&](const Entry& e) {
+        if (e.track != store->get(e.id))
+            stale.push_back(index);
+        ++index;
+    });
+    for (size_t i : stale) {
+        const TrackId id = revision.state[i].id;
+        revision.state.set(i, { id, store->get(id) });
+    }
+    revision.updates = store->updates();
+}
+
+void PlaylistImpl::trackUpdated(TrackId id)
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    const int index = indexOf(id);
+    if (index < 0)
+        return;
+
+    entries.set(size_t(index), { id, store->get(id) });
+    groupIndex.remove(id);
+    addToGroups(entries[size_t(index)]);
+}
+
+void PlaylistImpl::addToGroups(const Entry& entry)
+{
+    groupIndex.add(entry.id, entry.track->artist, entry.track->album, entry.track->lengthSeconds);
+}
+
+bool PlaylistImpl::undo()
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    if (undoStack.empty())
+        return false;
+
+    Revision revision = std::move(undoStack.back());
+    undoStack.pop_back();
+    addsOpen = false;
+    catchUp(revision);
+
+    // Groups and the playing index follow the edit being reverted
+    int playing = currentIndex();
+    if (revision.edit == Edit::Add) {
+        for (size_t i = entries.size() - revision.where; i < entries.size(); ++i)
+            groupIndex.remove(entries[i].id);
+        if (playing >= int(revision.state.size()))
+            playing = -1;
+    } else if (revision.edit == Edit::Remove) {
+        addToGroups(revision.state[revision.where]);
+        if (playing >= int(revision.where))
+            playing++;
+    }
+
+    redoStack.push_back({ entries, revision.edit, revision.where, store->updates() });
+    restore(std::move(revision.state), revision.edit, playing);
+    return true;
+}
+
+bool PlaylistImpl::redo()
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    if (redoStack.empty())
+        return false;
+
+    Revision revision = std::move(redoStack.back());
+    redoStack.pop_back();
+    addsOpen = false;
+    catchUp(revision);
+
+    int playing = currentIndex();
+    if (revision.edit == Edit::Add) {
+        const Snapshot& after = revision.state;
+        for (size_t i = after.size() - revision.where; i < after.size(); ++i)
+            addToGroups(after[i]);
+    } else if (revision.edit == Edit::Remove) {
+        groupIndex.remove(entries[revision.where].id);
+        if (playing == int(revision.where))
+            playing = -1;
+        else if (playing > int(revision.where))
+            playing--;
+    }
+
+    undoStack.push_back({ entries, revision.edit, revision.where, store->updates() });
+    restore(std::move(revision.state), revision.edit, playing);
+    return true;
+}
+
+void PlaylistImpl::clearHistory()
+{
+    undoStack.clear();
+    redoStack.clear();
+    addsOpen = false;
+
+    // Hand back tracks that only the history still referenced
+    std::vector<bool> present(store->idLimit(), false);
+    entries.forEach([&](const Entry& e) { present[e.id] = true; });
+    size_t kept = 0;
+    for (TrackId id : held) {
+        if (present[id])
+            held[kept++] = id;
+        else
+            store->release(id);
+    }
+    held.resize(kept);
+}
+
+// Switches to another version of the track list. playing is the index the
+// current track has there (-1 if it is gone); for a reorder it is looked
+// up by id instead. A shuffled order keeps its sequence for the tracks
+// both versions share.
+void PlaylistImpl::restore(Snapshot state, Edit edit, int playing)
+{
+    std::vector<TrackId> oldIds;
+    if (isShuffled || edit == Edit::Reorder) {
+        oldIds.reserve(entries.size());
+        entries.forEach([&](const Entry& e) { oldIds.push_back(e.id); });
+    }
+    const int oldPlaying = currentIndex();
+
+    entries = std::move(state);
+    positionsDirty = true;
+
+    if (edit == Edit::Reorder && oldPlaying >= 0)
+        playing = indexOf(oldIds[oldPlaying]);
+
+    if (isShuffled) {
+        std::vector<size_t> order;
+        order.reserve(entries.size());
+        std::vector<bool> placed(entries.size(), false);
+        for (size_t i : playbackOrder) {
+            int index = indexOf(oldIds[i]);
+            if (index >= 0) {
+                order.push_back(size_t(index));
+                placed[index] = true;
+            }
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (!placed[i])
+                order.push_back(i);
+        }
+        playbackOrder.swap(order);
+        current = entries.empty() ? -1 : 0;
+        if (playing >= 0)
+            setCurrent(size_t(playing));
+    } else {
+        rebuildPlaybackOrder();
+        current = entries.empty() ? -1 : std::max(playing, 0);
+    }
+}
+
+int PlaylistImpl::indexOf(TrackId id) const
+{
+    MemoryScope scope(MemoryTag::Playlist);
+    if (positionsDirty) {
+        positions.assign(store->idLimit(), -1);
+        int i = 0;
+        entries.forEach([&](const Entry& e) { positions[e.id] = i++; });
+        positionsDirty = false;
+    }
+    return id < positions.size() ? positions[id] : -1;
+}
+
+std::vector<size_t> PlaylistImpl::albumTracks(const std::string& artist, const std::string& album) const
+{
+    std::vector<size_t> result;
+    const GroupIndex::Album* group = groupIndex.findAlbum(artist, album);
+    if (!group)
+        return result;
+
+    for (TrackId id : group->tracks) {
+        int index = indexOf(id);
+        if (index >= 0)
+            result.push_back(size_t(index));
+    }
+    std::sort(result.begin(), result.end(), [this](size_t a, size_t b) {
+        int ta = entries[a].track->trackNumber, tb = entries[b].track->trackNumber;
+        if (ta != tb)
+            return ta < tb;
+        return a < b;
+    });
+    return result;
+}
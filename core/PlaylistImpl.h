@@ -1,12 +1,38 @@
 #pragma once
 
 #include "Playlist.h"
+#include "PlaylistSort.h"
+#include "GroupIndex.h"
+#include "PersistentVector.h"
+#include "TrackStore.h"
+#include <memory>
 #include <vector>
 
 class PlaylistImpl : public Playlist {
 public:
     enum class RepeatMode { Off, All, One };
+
+    struct Entry {
+        TrackId id;
+        std::shared_ptr<const Track> track;
+    };
+    // Immutable view of the tracks at one point in time
+    using Snapshot = PersistentVector<Entry>;
+
+    // A playlist with a store of its own
     PlaylistImpl();
+    // A playlist over a store shared with other playlists
+    explicit PlaylistImpl(std::shared_ptr<TrackStore> store);
+    // Fork: the same tracks in the same order, sharing structure with the
+    // source until either side is edited. History is not copied.
+    PlaylistImpl(const PlaylistImpl& source);
+    // The tracks of source at the given indices, in playlist order
+    PlaylistImpl(const PlaylistImpl& source, std::vector<size_t> indices);
+    // Tracks already in store, in the order given
+    PlaylistImpl(std::shared_ptr<TrackStore> store, const std::vector<TrackId>& ids);
+    ~PlaylistImpl();
+
+    PlaylistImpl& operator=(const PlaylistImpl&) = delete;
 
     void add(const Track& track) override;
     Track next() override;
@@ -14,18 +40,91 @@ public:
     bool empty() const override;
     Track at(size_t index) const override;
     void removeAt(size_t index);
+    // Indices of the next count tracks next() would return, honouring
+    // shuffle and repeat (empty for repeat-one)
+    std::vector<size_t> upcoming(size_t count) const;
+    // Makes the track at index current; next()/prev() continue from it
+    void setCurrent(size_t index);
+    // Index of the current track, or -1 when empty
+    int currentIndex() const;
     void rebuildPlaybackOrder();
 
+    // Stable multi-key sort. Returns the permutation that was applied
+    // (result[i] = previous index of the track now at i).
+    std::vector<size_t> sortBy(const std::vector<SortKey>& order);
+    // Reorders all tracks at once; the current track stays current
+    void applyPermutation(const std::vector<size_t>& order);
+
     bool shuffled(){ return isShuffled; }
     void shuffle(unsigned int seed);
     void disableShuffle();
     void setRepeatMode(RepeatMode mode) { repeatMode = mode; }
     RepeatMode getRepeatMode() const { return repeatMode; }
 
-    size_t size() const { return tracks.size(); }
+    size_t size() const { return entries.size(); }
+    const std::shared_ptr<TrackStore>& trackStore() const { return store; }
+
+    // Consistent copy of the track list in O(1); safe to read from other
+    // threads while the playlist keeps changing
+    Snapshot snapshot() const { return entries; }
+
+    // Unlimited undo / redo of add, remove and reorder. Each edit keeps the
+    // previous snapshot, which shares all but O(log n) nodes with the
+    // current one. A run of consecutive add() calls undoes as one step.
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+    bool undo();
+    bool redo();
+    // Ends the current run of add() calls
+    void checkpoint() { addsOpen = false; }
+    // Drops undo / redo history and the store references only it needed
+    void clearHistory();
+
+    // Picks up the store's new version of a track (after
+    // TrackStore::update); undo / redo snapshots catch up when restored
+    void trackUpdated(TrackId id);
+
+    // Artist / album groups, kept up to date by add() and removeAt()
+    const GroupIndex& groups() const { return groupIndex; }
+    TrackId idAt(size_t index) const { return index < entries.size() ? entries[index].id : TrackId(-1); }
+    // Current index of a track id, or -1 if it is not in the playlist
+    int indexOf(TrackId id) const;
+    // Indices of an album's tracks ordered by track number (for "play album")
+    std::vector<size_t> albumTracks(const std::string& artist, const std::string& album) const;
 
 private:
-    std::vector<Track> tracks;
+    enum class Edit { Add, Remove, Reorder };
+
+    // One undo (or redo) step: the state to return to and what changed,
+    // so the group index can be patched instead of rebuilt
+    struct Revision {
+        Snapshot state;
+        Edit edit;
+        size_t where; // Add: number of tracks appended; Remove: index
+        uint64_t updates; // TrackStore::updates() when state was current
+    };
+
+    static std::vector<TrackId> idsAt(const PlaylistImpl& source, std::vector<size_t> indices);
+    void record(Edit edit, size_t where);
+    void catchUp(Revision& revision) const;
+    void restore(Snapshot state, Edit edit, int playing);
+    void addToGroups(const Entry& entry);
+
+    std::shared_ptr<TrackStore> store;
+    // Every id this playlist holds a store reference for: the current
+    // tracks plus any that only undo / redo history still needs
+    std::vector<TrackId> held;
+
+    Snapshot entries;
+    GroupIndex groupIndex;
+
+    std::vector<Revision> undoStack;
+    std::vector<Revision> redoStack;
+    bool addsOpen = false;
+
+    // id -> index, rebuilt lazily after removals and sorts
+    mutable std::vector<int> positions;
+    mutable bool positionsDirty = false;
     std::vector<size_t> playbackOrder;
     int current;
     bool isShuffled;
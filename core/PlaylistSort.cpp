@@ -0,0 +1,311 @@
+#include "PlaylistSort.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Below this a single-threaded sort wins over thread start-up
+constexpr size_t kParallelThreshold = 1 << 15;
+
+// Stable sort that splits large ranges into per-core chunks and merges
+// neighbouring runs pairwise. Both steps are stable, so the result is too.
+template <typename T, typename Less>
+void parallelStableSort(std::vector<T>& v, Less less)
+{
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    if (v.size() < kParallelThreshold || workers == 1) {
+        std::stable_sort(v.begin(), v.end(), less);
+        return;
+    }
+
+    workers = std::min<size_t>(workers, 16);
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= workers; ++i)
+        bounds.push_back(v.size() * i / workers);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; ++i) {
+        threads.emplace_back([&, i] {
+            std::stable_sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], less);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged;
+        threads.clear();
+        for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+            size_t lo = bounds[i], mid = bounds[i + 1], hi = bounds[i + 2];
+            threads.emplace_back([&, lo, mid, hi] {
+                std::inplace_merge(v.begin() + lo, v.begin() + mid, v.begin() + hi, less);
+            });
+            merged.push_back(lo);
+        }
+        if (bounds.size() % 2 == 0)
+            merged.push_back(bounds[bounds.size() - 2]); // odd run out, carried over
+        merged.push_back(bounds.back());
+
+        for (auto& t : threads)
+            t.join();
+        bounds.swap(merged);
+    }
+}
+
+using KeyedIndex = std::pair<uint64_t, uint32_t>;
+
+// Stable LSD radix sort on the 64-bit key, 11 bits per pass. Passes where
+// every key has the same digit (typically the high bits) are skipped.
+void radixSort(KeyedIndex* data, size_t n)
+{
+    if (n < 256) {
+        std::stable_sort(data, data + n, [](const KeyedIndex& a, const KeyedIndex& b) {
+            return a.first < b.first;
+        });
+        return;
+    }
+
+    constexpr int kBits = 11;
+    constexpr size_t kBuckets = size_t(1) << kBits;
+    std::vector<KeyedIndex> scratch(n);
+    KeyedIndex* src = data;
+    KeyedIndex* dst = scratch.data();
+
+    for (int shift = 0; shift < 64; shift += kBits) {
+        size_t counts[kBuckets] = {};
+        for (size_t i = 0; i < n; ++i)
+            ++counts[(src[i].first >> shift) & (kBuckets - 1)];
+        if (counts[(src[0].first >> shift) & (kBuckets - 1)] == n)
+            continue;
+
+        size_t sum = 0;
+        for (size_t& c : counts) {
+            size_t here = c;
+            c = sum;
+            sum += here;
+        }
+        for (size_t i = 0; i < n; ++i)
+            dst[counts[(src[i].first >> shift) & (kBuckets - 1)]++] = src[i];
+        std::swap(src, dst);
+    }
+
+    if (src != data)
+        std::copy(src, src + n, data);
+}
+
+const std::string& stringField(const CollationKeys& k, SortField field)
+{
+    switch (field) {
+    case SortField::Artist: return k.artist;
+    case SortField::Album:  return k.album;
+    default:                return k.title;
+    }
+}
+
+// Sorts v[lo, hi) by the strings' bytes from offset on. v[lo, hi) must be
+// in index order on entry; the sort is stable, so ties stay that way.
+template <typename StringOf>
+void sortByChunks(std::vector<KeyedIndex>& v, size_t lo, size_t hi,
+                  size_t offset, const StringOf& str)
+{
+    bool longer = false;
+    for (size_t i = lo; i < hi; ++i) {
+        const std::string& s = str(v[i].second);
+        uint64_t chunk = 0;
+        for (size_t b = offset; b < offset + 8; ++b)
+            chunk = (chunk << 8) | (b < s.size() ? (unsigned char)s[b] : 0);
+        v[i].first = chunk;
+        longer = longer || s.size() > offset + 8;
+    }
+
+    radixSort(v.data() + lo, hi - lo);
+
+    if (!longer)
+        return;
+    for (size_t i = lo; i < hi;) {
+        size_t j = i + 1;
+        while (j < hi && v[j].first == v[i].first)
+            ++j;
+        if (j - i > 1)
+            sortByChunks(v, i, j, offset + 8, str);
+        i = j;
+    }
+}
+
+// Dense rank of every track's value for one field: equal values share a
+// rank and ranks follow the field's order. Strings are compared once per
+// distinct value instead of once per track comparison.
+std::vector<uint32_t> fieldRanks(const std::vector<const Track*>& tracks,
+                                 const std::vector<const CollationKeys*>& keys,
+                                 SortField field, uint32_t& distinct)
+{
+    std::vector<uint32_t> ranks(tracks.size());
+
+    if (field == SortField::TrackNumber || field == SortField::Length) {
+        auto value = [&](size_t i) {
+            return field == SortField::TrackNumber ? tracks[i]->trackNumber : tracks[i]->lengthSeconds;
+        };
+        int lo = 0, hi = 0;
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            lo = i == 0 ? value(i) : std::min(lo, value(i));
+            hi = i == 0 ? value(i) : std::max(hi, value(i));
+        }
+        for (size_t i = 0; i < tracks.size(); ++i)
+            ranks[i] = uint32_t(value(i) - lo);
+        distinct = tracks.empty() ? 0 : uint32_t(hi - lo) + 1;
+        return ranks;
+    }
+
+    // Few distinct values (artist, album): dedupe through a hash table and
+    // only sort the distinct strings
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::vector<std::string_view> values;
+    const size_t maxDistinct = tracks.size() / 8 + 16;
+    size_t i = 0;
+    for (; i < tracks.size() && values.size() <= maxDistinct; ++i) {
+        if (i == 4096 && values.size() * 2 > i)
+            break; // sample says mostly distinct: don't build the table
+        std::string_view s = stringField(*keys[i], field);
+        auto it = ids.try_emplace(s, uint32_t(values.size())).first;
+        if (it->second == values.size())
+            values.push_back(s);
+        ranks[i] = it->second;
+    }
+
+    if (i == tracks.size()) {
+        std::vector<uint32_t> byValue(values.size());
+        std::iota(byValue.begin(), byValue.end(), 0);
+        parallelStableSort(byValue, [&](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+
+        std::vector<uint32_t> rankOfId(values.size());
+        for (uint32_t r = 0; r < byValue.size(); ++r)
+            rankOfId[byValue[r]] = r;
+        for (uint32_t& r : ranks)
+            r = rankOfId[r];
+
+        distinct = uint32_t(values.size());
+        return ranks;
+    }
+
+    // Mostly distinct values (titles): radix-style sort on 8-byte chunks.
+    // Each pass sorts a run of equal prefixes by its next chunk, so strings
+    // are read sequentially per pass instead of on every comparison.
+    std::vector<KeyedIndex> order(tracks.size());
+    for (size_t t = 0; t < tracks.size(); ++t)
+        order[t] = { 0, uint32_t(t) };
+    sortByChunks(order, 0, order.size(), 0, [&](uint32_t t) -> const std::string& {
+        return stringField(*keys[t], field);
+    });
+
+    uint32_t rank = 0;
+    for (size_t t = 0; t < order.size(); ++t) {
+        if (t > 0 && stringField(*keys[order[t].second], field) != stringField(*keys[order[t - 1].second], field))
+            ++rank;
+        ranks[order[t].second] = rank;
+    }
+    distinct = tracks.empty() ? 0 : rank + 1;
+    return ranks;
+}
+
+int bitsFor(uint32_t distinct)
+{
+    int bits = 0;
+    while (bits < 32 && (uint64_t(1) << bits) < distinct)
+        ++bits;
+    return bits;
+}
+
+}
+
+std::vector<SortKey> defaultSortKeys()
+{
+    return {
+        { SortField::Artist },
+        { SortField::Album },
+        { SortField::TrackNumber },
+        { SortField::Title },
+    };
+}
+
+bool parseSortKeys(const std::string& spec, std::vector<SortKey>& out)
+{
+    std::vector<SortKey> keys;
+    std::stringstream ss(spec);
+    std::string name;
+
+    while (std::getline(ss, name, ',')) {
+        SortKey key{ SortField::Title };
+        if (!name.empty() && name[0] == '-') {
+            key.descending = true;
+            name.erase(0, 1);
+        }
+
+        if (name == "title")       key.field = SortField::Title;
+        else if (name == "artist") key.field = SortField::Artist;
+        else if (name == "album")  key.field = SortField::Album;
+        else if (name == "track")  key.field = SortField::TrackNumber;
+        else if (name == "length") key.field = SortField::Length;
+        else return false;
+
+        keys.push_back(key);
+    }
+
+    if (keys.empty())
+        return false;
+    out = std::move(keys);
+    return true;
+}
+
+std::vector<size_t> sortPermutation(const std::vector<const Track*>& tracks,
+                                    const std::vector<const CollationKeys*>& keys,
+                                    const std::vector<SortKey>& order)
+{
+    const size_t n = tracks.size();
+
+    // Reduce every sort field to an integer rank
+    std::vector<std::vector<uint32_t>> ranks;
+    int totalBits = 0;
+    std::vector<int> widths;
+    for (const SortKey& key : order) {
+        uint32_t distinct = 0;
+        ranks.push_back(fieldRanks(tracks, keys, key.field, distinct));
+        if (key.descending) {
+            for (uint32_t& r : ranks.back())
+                r = distinct - 1 - r;
+        }
+        widths.push_back(bitsFor(distinct));
+        totalBits += widths.back();
+    }
+
+    std::vector<size_t> perm(n);
+
+    if (totalBits <= 64) {
+        // Common case: all ranks pack into one integer per track
+        std::vector<KeyedIndex> packed(n);
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t k = 0;
+            for (size_t f = 0; f < ranks.size(); ++f)
+                k = (widths[f] == 64 ? 0 : k << widths[f]) | ranks[f][i];
+            packed[i] = { k, uint32_t(i) };
+        }
+        radixSort(packed.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            perm[i] = packed[i].second;
+        return perm;
+    }
+
+    std::iota(perm.begin(), perm.end(), 0);
+    parallelStableSort(perm, [&](size_t a, size_t b) {
+        for (const auto& r : ranks) {
+            if (r[a] != r[b])
+                return r[a] < r[b];
+        }
+        return false;
+    });
+    return perm;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Collation.h"
+#include "Playlist.h"
+
+#include <string>
+#include <vector>
+
+enum class SortField { Title, Artist, Album, TrackNumber, Length };
+
+struct SortKey {
+    SortField field;
+    bool descending = false;
+};
+
+// artist -> album -> track number -> title
+std::vector<SortKey> defaultSortKeys();
+
+// Parses "artist,album,-length": comma separated field names
+// (title, artist, album, track, length), '-' prefix for descending.
+bool parseSortKeys(const std::string& spec, std::vector<SortKey>& out);
+
+// Stable sort permutation: result[i] is the index of the track that moves
+// to position i. keys[i] must belong to tracks[i]. Large inputs are sorted
+// in parallel chunks and merged.
+std::vector<size_t> sortPermutation(const std::vector<const Track*>& tracks,
+                                    const std::vector<const CollationKeys*>& keys,
+                                    const std::vector<SortKey>& order);
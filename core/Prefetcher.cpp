@@ -0,0 +1,190 @@
+#include "Prefetcher.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint64_t kChunk = 1ull << 20;
+
+#ifdef __linux__
+// Whether at least 90% of the first length bytes of fd are in the page cache
+bool headResident(int fd, uint64_t length)
+{
+    if (length == 0)
+        return false;
+    void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+    bool resident = false;
+    const size_t page = size_t(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages((length + page - 1) / page);
+    if (mincore(map, length, pages.data()) == 0) {
+        size_t cached = std::count_if(pages.begin(), pages.end(), [](unsigned char r) { return r & 1; });
+        resident = cached * 10 >= pages.size() * 9;
+    }
+    munmap(map, length);
+    return resident;
+}
+#endif
+
+}
+
+Prefetcher::Prefetcher(Config config)
+    : config(config)
+{
+#ifdef __linux__
+    worker = std::thread(&Prefetcher::run, this);
+#endif
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+void Prefetcher::follow(const PlaylistImpl& playlist)
+{
+    std::vector<std::string> files;
+    for (size_t index : playlist.upcoming(config.lookahead))
+        files.push_back(playlist.at(index).filename);
+    schedule(std::move(files));
+}
+
+void Prefetcher::schedule(std::vector<std::string> files)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.clear();
+        uint64_t budget = 0;
+        for (auto& file : files) {
+            if (budget + config.bytesPerTrack > config.memoryBudget)
+                break;
+            budget += config.bytesPerTrack;
+            queue.push_back(std::move(file));
+        }
+        generation++;
+    }
+    wake.notify_one();
+}
+
+void Prefetcher::trackStarted(const std::string& filename)
+{
+#ifdef __linux__
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    uint64_t length = 0;
+    if (fstat(fd, &st) == 0)
+        length = std::min<uint64_t>(uint64_t(st.st_size), config.bytesPerTrack);
+
+    // A start counts as a hit when the head we would have warmed is resident
+    bool hit = headResident(fd, length);
+    close(fd);
+
+    (hit ? hits : misses)++;
+#else
+    (void)filename;
+#endif
+}
+
+Prefetcher::Stats Prefetcher::stats() const
+{
+    Stats s;
+    s.hits = hits.load();
+    s.misses = misses.load();
+    s.warmedFiles = warmedFiles.load();
+    s.warmedBytes = warmedBytes.load();
+    return s;
+}
+
+void Prefetcher::run()
+{
+    for (;;) {
+        std::string file;
+        uint64_t seen;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            file = std::move(queue.front());
+            queue.pop_front();
+            seen = generation;
+        }
+
+        warm(file, seen);
+    }
+}
+
+// Reads the file head in chunks, sleeping as needed to stay within the
+// bandwidth budget. Gives up early when a newer schedule arrives. A head
+// still in the page cache is left alone, however long ago it was warmed;
+// one that was evicted since (a small playlist on repeat) is read again.
+void Prefetcher::warm(const std::string& filename, uint64_t seen)
+{
+#ifdef __linux__
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return;
+    }
+
+    const uint64_t length = std::min<uint64_t>(uint64_t(st.st_size), config.bytesPerTrack);
+    if (headResident(fd, length)) {
+        close(fd);
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t done = 0;
+    bool complete = true;
+
+    while (done < length) {
+        uint64_t chunk = std::min(kChunk, length - done);
+        if (readahead(fd, off_t(done), size_t(chunk)) != 0)
+            posix_fadvise(fd, off_t(done), off_t(chunk), POSIX_FADV_WILLNEED);
+        done += chunk;
+        warmedBytes += chunk;
+
+        // Token bucket: done bytes may not take less than done / bandwidth
+        if (config.bandwidth > 0) {
+            auto due = start + std::chrono::microseconds(done * 1000000 / config.bandwidth);
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_until(lock, due, [&] { return generation != seen; });
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (generation != seen) {
+            complete = done >= length;
+            break;
+        }
+    }
+    close(fd);
+
+    if (complete)
+        warmedFiles++;
+#else
+    (void)filename;
+    (void)seen;
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "PlaylistImpl.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Warms the page cache for the tracks that will play next, so a track
+// start on spinning disks or NFS does not wait on cold I/O.
+//
+// A worker thread reads the head of each upcoming file with readahead()
+// (falling back to posix_fadvise(WILLNEED)), paced to a bandwidth budget
+// and capped by a total byte budget. Heads mincore() finds still cached
+// are skipped, so an evicted one is warmed again on its next turn.
+// trackStarted() makes the same check to count hits / misses.
+// On platforms without these calls the prefetcher does nothing.
+class Prefetcher {
+public:
+    struct Config {
+        size_t lookahead = 3;                   // upcoming tracks to warm
+        uint64_t bytesPerTrack = 4ull << 20;    // head of each file
+        uint64_t memoryBudget = 32ull << 20;    // bytes hinted per schedule
+        uint64_t bandwidth = 16ull << 20;       // bytes per second
+    };
+
+    struct Stats {
+        uint64_t hits = 0;        // track starts served from page cache
+        uint64_t misses = 0;
+        uint64_t warmedFiles = 0;
+        uint64_t warmedBytes = 0;
+    };
+
+    Prefetcher() : Prefetcher(Config()) {}
+    explicit Prefetcher(Config config);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // Queues the tracks after the current one in playback order (shuffle
+    // and repeat included), replacing whatever was queued before
+    void follow(const PlaylistImpl& playlist);
+    void schedule(std::vector<std::string> files);
+
+    // Call before the player opens the file
+    void trackStarted(const std::string& filename);
+
+    Stats stats() const;
+
+private:
+    void run();
+    void warm(const std::string& filename, uint64_t generation);
+
+    const Config config;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> warmedFiles{0};
+    std::atomic<uint64_t> warmedBytes{0};
+
+    // Guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::string> queue;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    std::thread worker;
+};
@@ -0,0 +1,97 @@
+#include "RealFft.h"
+
+#include <cmath>
+
+RealFft::RealFft(size_t size)
+    : n(size),
+    half(size / 2),
+    bitReverse(size / 2),
+    stageRe(size / 2),
+    stageIm(size / 2),
+    splitRe(size / 2 + 1),
+    splitIm(size / 2 + 1),
+    re(size / 2),
+    im(size / 2)
+{
+    const double pi = 3.14159265358979323846;
+
+    int bits = 0;
+    while ((size_t(1) << bits) < half)
+        ++bits;
+
+    for (size_t i = 0; i < half; ++i) {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; ++b)
+            if (i & (size_t(1) << b))
+                r |= 1u << (bits - 1 - b);
+        bitReverse[i] = r;
+    }
+
+    // Twiddles for the stage with butterfly span len start at len/2 - 1
+    for (size_t len = 2; len <= half; len <<= 1) {
+        size_t offset = len / 2 - 1;
+        for (size_t j = 0; j < len / 2; ++j) {
+            double angle = -2.0 * pi * double(j) / double(len);
+            stageRe[offset + j] = float(std::cos(angle));
+            stageIm[offset + j] = float(std::sin(angle));
+        }
+    }
+
+    for (size_t k = 0; k <= half; ++k) {
+        double angle = -2.0 * pi * double(k) / double(n);
+        splitRe[k] = float(std::cos(angle));
+        splitIm[k] = float(std::sin(angle));
+    }
+}
+
+void RealFft::powerSpectrum(const float* in, float* out)
+{
+    float* zr = re.data();
+    float* zi = im.data();
+
+    // Pack even samples into the real part and odd samples into the imaginary
+    // part, in bit-reversed order for the in-place decimation-in-time passes.
+    for (size_t i = 0; i < half; ++i) {
+        uint32_t r = bitReverse[i];
+        zr[r] = in[2 * i];
+        zi[r] = in[2 * i + 1];
+    }
+
+    for (size_t len = 2; len <= half; len <<= 1) {
+        const size_t span = len / 2;
+        const float* wr = stageRe.data() + (span - 1);
+        const float* wi = stageIm.data() + (span - 1);
+
+        for (size_t start = 0; start < half; start += len) {
+            float* ar = zr + start;
+            float* ai = zi + start;
+            float* br = zr + start + span;
+            float* bi = zi + start + span;
+
+            for (size_t j = 0; j < span; ++j) {
+                float tr = br[j] * wr[j] - bi[j] * wi[j];
+                float ti = br[j] * wi[j] + bi[j] * wr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+
+    // Unpack: X[k] = Fe[k] + W^k * Fo[k], where Fe/Fo are the spectra of the
+    // even/odd samples recovered from Z[k] and conj(Z[half - k]).
+    for (size_t k = 0; k <= half; ++k) {
+        size_t a = (k == half) ? 0 : k;
+        size_t b = (k == 0) ? 0 : half - k;
+
+        float feRe = 0.5f * (zr[a] + zr[b]);
+        float feIm = 0.5f * (zi[a] - zi[b]);
+        float foRe = 0.5f * (zi[a] + zi[b]);
+        float foIm = -0.5f * (zr[a] - zr[b]);
+
+        float xr = feRe + splitRe[k] * foRe - splitIm[k] * foIm;
+        float xi = feIm + splitRe[k] * foIm + splitIm[k] * foRe;
+        out[k] = xr * xr + xi * xi;
+    }
+}
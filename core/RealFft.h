@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Power-of-two real FFT.
+//
+// The real input of size n is packed into an n/2-point complex FFT and
+// unpacked afterwards, so the transform costs roughly half of a complex FFT
+// of the same length. Real and imaginary parts live in separate arrays and
+// every stage's twiddles are stored contiguously, which keeps the butterfly
+// loops free of strided access so the compiler can vectorize them.
+class RealFft {
+public:
+    explicit RealFft(size_t size); // size must be a power of two, >= 4
+
+    size_t size() const { return n; }
+    size_t bins() const { return n / 2 + 1; }
+
+    // Writes bins() squared magnitudes |X[k]|^2 for k = 0..n/2 into out.
+    void powerSpectrum(const float* in, float* out);
+
+private:
+    size_t n;
+    size_t half;
+
+    std::vector<uint32_t> bitReverse;
+    std::vector<float> stageRe, stageIm; // per-stage twiddles, stage s at offset (len/2 - 1)
+    std::vector<float> splitRe, splitIm; // e^{-2*pi*i*k/n} for the real unpacking step
+    std::vector<float> re, im;           // work buffers
+};
@@ -0,0 +1,113 @@
+#include "SimulatedBackend.h"
+
+#include <algorithm>
+
+SimulatedBackend::SimulatedBackend(Config config)
+    : config(config)
+{
+}
+
+void SimulatedBackend::load(const std::string& filename)
+{
+    auto it = lengths.find(filename);
+    length = it != lengths.end() ? it->second : config.defaultLengthMs;
+    loaded = true;
+    pausedAt = 0;
+    openedAt = clock + config.openLatencyMs;
+    setState(State::Buffering);
+}
+
+void SimulatedBackend::play()
+{
+    if (current == State::Paused) {
+        playedFrom = pausedAt;
+        playStart = clock;
+        setState(State::Playing);
+    } else if (current == State::Stopped && loaded) {
+        pausedAt = 0;
+        openedAt = clock + config.openLatencyMs;
+        setState(State::Buffering);
+    }
+}
+
+void SimulatedBackend::pause()
+{
+    if (current != State::Playing)
+        return;
+    pausedAt = position();
+    setState(State::Paused);
+}
+
+void SimulatedBackend::stop()
+{
+    pausedAt = 0;
+    setState(State::Stopped);
+}
+
+void SimulatedBackend::seek(int64_t ms)
+{
+    ms = std::clamp<int64_t>(ms, 0, length);
+    if (current == State::Playing) {
+        playedFrom = ms;
+        playStart = clock;
+    } else {
+        pausedAt = ms;
+    }
+}
+
+int64_t SimulatedBackend::position() const
+{
+    if (current != State::Playing)
+        return pausedAt;
+    return std::min(length, playedFrom + (clock - playStart));
+}
+
+PlaybackBackend::Clock::time_point SimulatedBackend::now() const
+{
+    return Clock::time_point(std::chrono::milliseconds(clock));
+}
+
+void SimulatedBackend::advance(int64_t ms)
+{
+    const int64_t until = clock + ms;
+    for (int64_t due = nextEvent(); due >= 0 && due <= until; due = nextEvent())
+        runNext();
+    clock = until;
+}
+
+bool SimulatedBackend::runNext()
+{
+    const int64_t due = nextEvent();
+    if (due < 0)
+        return false;
+    clock = std::max(clock, due);
+
+    if (current == State::Buffering) {
+        playedFrom = pausedAt;
+        playStart = clock;
+        emitDuration(length);
+        setState(State::Playing);
+    } else {
+        pausedAt = 0;
+        setState(State::Stopped);
+        emitEndOfTrack();
+    }
+    return true;
+}
+
+int64_t SimulatedBackend::nextEvent() const
+{
+    if (current == State::Buffering)
+        return openedAt;
+    if (current == State::Playing)
+        return playStart + (length - playedFrom);
+    return -1;
+}
+
+void SimulatedBackend::setState(State state)
+{
+    if (state == current)
+        return;
+    current = state;
+    emitState(state);
+}
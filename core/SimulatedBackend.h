@@ -0,0 +1,62 @@
+#pragma once
+
+#include "PlaybackBackend.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// A PlaybackBackend that plays nothing, on a virtual clock. Opening a file
+// takes a fixed openLatency and a track lasts as long as setLength() said
+// (defaultLength otherwise). Time only moves in advance() / runNext(),
+// and events fire there in time order, so runs are deterministic and a
+// day of playback takes microseconds. Meant for benchmarks and checks of
+// the sequencing rules.
+class SimulatedBackend : public PlaybackBackend {
+public:
+    struct Config {
+        int64_t openLatencyMs = 20;
+        int64_t defaultLengthMs = 180000;
+    };
+
+    SimulatedBackend() : SimulatedBackend(Config()) {}
+    explicit SimulatedBackend(Config config);
+
+    void setLength(const std::string& filename, int64_t ms) { lengths[filename] = ms; }
+
+    void load(const std::string& filename) override;
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void seek(int64_t ms) override;
+
+    State state() const override { return current; }
+    int64_t position() const override;
+    int64_t duration() const override { return length; }
+    Clock::time_point now() const override;
+
+    // Virtual milliseconds since construction
+    int64_t elapsed() const { return clock; }
+    // Moves the clock forward by ms, running every event due on the way
+    void advance(int64_t ms);
+    // Jumps to the next event (a file opening or a track ending) and runs
+    // it; false when nothing is due, e.g. stopped or paused
+    bool runNext();
+
+private:
+    // When the next event is due, or -1 when none is
+    int64_t nextEvent() const;
+    void setState(State state);
+
+    const Config config;
+    std::unordered_map<std::string, int64_t> lengths;
+
+    int64_t clock = 0;
+    State current = State::Stopped;
+    bool loaded = false;
+    int64_t length = 0;
+    int64_t openedAt = 0;   // Buffering: when the file is open
+    int64_t playedFrom = 0; // Playing: position at playStart
+    int64_t playStart = 0;
+    int64_t pausedAt = 0;   // position while not playing
+};
@@ -0,0 +1,148 @@
+#include "SpectrumAnalyzer.h"
+#include "MemoryStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr float kMinFrequency = 60.0f;
+constexpr float kMaxFrequency = 16000.0f;
+constexpr float kFloorDb = -70.0f;
+
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer(int bandCount, size_t fftSize)
+    : numBands(std::clamp(bandCount, 1, kMaxBands)),
+    frameSize(fftSize),
+    fft(fftSize)
+{
+    MemoryScope scope(MemoryTag::Audio);
+    window.resize(fftSize);
+    windowed.resize(fftSize);
+    power.resize(fft.bins());
+    ring.assign(fftSize, 0.0f);
+
+    const double pi = 3.14159265358979323846;
+    for (size_t i = 0; i < frameSize; ++i)
+        window[i] = float(0.5 - 0.5 * std::cos(2.0 * pi * double(i) / double(frameSize - 1)));
+
+    worker = std::thread(&SpectrumAnalyzer::run, this);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void SpectrumAnalyzer::pushSamples(const float* samples, size_t count, int rate)
+{
+    if (count == 0)
+        return;
+
+    // Only the most recent frame matters
+    if (count > frameSize) {
+        samples += count - frameSize;
+        count = frameSize;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t first = std::min(count, frameSize - writePos);
+        std::copy(samples, samples + first, ring.begin() + writePos);
+        std::copy(samples + first, samples + count, ring.begin());
+        writePos = (writePos + count) % frameSize;
+        if (rate > 0)
+            sampleRate = rate;
+        pending = true;
+    }
+    wake.notify_one();
+}
+
+void SpectrumAnalyzer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(ring.begin(), ring.end(), 0.0f);
+    writePos = 0;
+    pending = false;
+    ++generation;
+    snapshot.store(0, std::memory_order_release);
+}
+
+SpectrumAnalyzer::Bands SpectrumAnalyzer::bands() const
+{
+    uint64_t packed = snapshot.load(std::memory_order_acquire);
+    Bands out{};
+    for (int b = 0; b < kMaxBands; ++b)
+        out[b] = uint8_t(packed >> (8 * b));
+    return out;
+}
+
+void SpectrumAnalyzer::run()
+{
+    MemoryScope scope(MemoryTag::Audio);
+    std::vector<float> frame(frameSize);
+
+    for (;;) {
+        int rate;
+        uint64_t seenGeneration;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return pending || stopping; });
+            if (stopping)
+                return;
+            pending = false;
+
+            // Unroll the ring so the oldest sample comes first
+            std::copy(ring.begin() + writePos, ring.end(), frame.begin());
+            std::copy(ring.begin(), ring.begin() + writePos, frame.begin() + (frameSize - writePos));
+            rate = sampleRate;
+            seenGeneration = generation;
+        }
+
+        uint64_t packed = analyze(frame, rate);
+
+        // A clear() that raced with the analysis wins
+        std::lock_guard<std::mutex> lock(mutex);
+        if (generation == seenGeneration)
+            snapshot.store(packed, std::memory_order_release);
+    }
+}
+
+uint64_t SpectrumAnalyzer::analyze(const std::vector<float>& frame, int rate)
+{
+    for (size_t i = 0; i < frameSize; ++i)
+        windowed[i] = frame[i] * window[i];
+
+    fft.powerSpectrum(windowed.data(), power.data());
+
+    // A full-scale sine under a Hann window peaks at n/4
+    const float fullScale = float(frameSize) * float(frameSize) / 16.0f;
+    const float binWidth = float(rate) / float(frameSize);
+    const float top = std::min(kMaxFrequency, float(rate) / 2.0f);
+    const float ratio = top / kMinFrequency;
+    const size_t lastBin = fft.bins() - 1;
+
+    uint64_t packed = 0;
+    for (int b = 0; b < numBands; ++b) {
+        float lo = kMinFrequency * std::pow(ratio, float(b) / numBands);
+        float hi = kMinFrequency * std::pow(ratio, float(b + 1) / numBands);
+        size_t first = std::min(lastBin, size_t(lo / binWidth));
+        size_t last = std::min(lastBin, std::max(first, size_t(hi / binWidth)));
+
+        float peak = 0.0f;
+        for (size_t k = first; k <= last; ++k)
+            peak = std::max(peak, power[k]);
+
+        float db = 10.0f * std::log10(peak / fullScale + 1e-12f);
+        float level = std::clamp((db - kFloorDb) / -kFloorDb, 0.0f, 1.0f);
+        packed |= uint64_t(level * 255.0f + 0.5f) << (8 * b);
+    }
+
+    return packed;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "RealFft.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Turns the PCM stream that is currently playing into a handful of
+// log-spaced frequency bands for the playing-track indicator.
+//
+// The audio side only copies samples into a ring buffer; the FFT runs on a
+// worker thread. Band levels are quantized to 8 bits and packed into a single
+// 64-bit atomic, so readers always see a consistent snapshot without locking.
+class SpectrumAnalyzer {
+public:
+    static constexpr int kMaxBands = 8;
+    using Bands = std::array<uint8_t, kMaxBands>;
+
+    explicit SpectrumAnalyzer(int bandCount = kMaxBands, size_t fftSize = 1024);
+    ~SpectrumAnalyzer();
+
+    SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+    SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+    // Appends mono samples in [-1, 1] and schedules a new analysis.
+    void pushSamples(const float* samples, size_t count, int sampleRate);
+    // Drops buffered audio and publishes silence (pause / stop).
+    void clear();
+
+    int bandCount() const { return numBands; }
+    // Latest levels, 0..255 per band. Safe to call from any thread.
+    Bands bands() const;
+
+private:
+    void run();
+    uint64_t analyze(const std::vector<float>& frame, int rate);
+
+    const int numBands;
+    const size_t frameSize;
+
+    RealFft fft;
+    std::vector<float> window;
+    std::vector<float> windowed; // worker thread only
+    std::vector<float> power;    // worker thread only
+
+    std::atomic<uint64_t> snapshot{0};
+
+    // Guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<float> ring;
+    size_t writePos = 0;
+    int sampleRate = 44100;
+    uint64_t generation = 0;
+    bool pending = false;
+    bool stopping = false;
+
+    std::thread worker;
+};
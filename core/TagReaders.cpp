@@ -0,0 +1,54 @@
+#include "TagReaders.h"
+#include "FlacReader.h"
+#include "Mp3Reader.h"
+#include "OggVorbisReader.h"
+#include "WavReader.h"
+
+#include <fstream>
+#include <vector>
+
+const TagFormat TagReaders::mp3 = { "mp3", &Mp3Reader::sniff, &Mp3Reader::read };
+const TagFormat TagReaders::flac = { "flac", &FlacReader::sniff, &FlacReader::read };
+const TagFormat TagReaders::oggVorbis = { "ogg", &OggVorbisReader::sniff, &OggVorbisReader::read };
+const TagFormat TagReaders::wav = { "wav", &WavReader::sniff, &WavReader::read };
+
+namespace {
+
+std::vector<const TagFormat*>& formats()
+{
+    static std::vector<const TagFormat*> list = {
+        &TagReaders::flac, &TagReaders::oggVorbis, &TagReaders::wav, &TagReaders::mp3
+    };
+    return list;
+}
+
+}
+
+void TagReaders::add(const TagFormat& format)
+{
+    formats().insert(formats().begin(), &format);
+}
+
+const TagFormat& TagReaders::detect(const char* head, size_t length)
+{
+    for (const TagFormat* format : formats()) {
+        if (format->sniff(head, length))
+            return *format;
+    }
+    return mp3;
+}
+
+TrackMetadata TagReaders::read(const std::string& filename, unsigned fields)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        return TrackMetadata();
+
+    char head[kSniffSize];
+    file.read(head, kSniffSize);
+    const TagFormat& format = detect(head, size_t(file.gcount()));
+
+    file.clear();
+    file.seekg(0);
+    return format.read(file, fields);
+}
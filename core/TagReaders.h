@@ -0,0 +1,39 @@
+#pragma once
+
+#include "TrackMetadata.h"
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+// One audio format tags can be read from
+struct TagFormat {
+    const char* name;
+    // Whether a file starting with these bytes is in this format
+    bool (*sniff)(const char* head, size_t length);
+    // From the file, positioned at its start
+    TrackMetadata (*read)(std::istream& file, unsigned fields);
+};
+
+// Picks the reader for a file from its first bytes rather than its
+// extension, so a mislabelled file still gets the right one. FLAC, Ogg
+// Vorbis and WAV are built in; anything else is read as MP3, which also
+// covers MPEG files with no ID3v2 tag.
+class TagReaders {
+public:
+    static const TagFormat mp3;
+    static const TagFormat flac;
+    static const TagFormat oggVorbis;
+    static const TagFormat wav;
+
+    // Bytes of the file start that detect() needs (fewer for a shorter file)
+    static constexpr size_t kSniffSize = 12;
+
+    // Tried before the formats already known. format must outlive every
+    // read. Not thread-safe: add formats at startup, before any scan.
+    static void add(const TagFormat& format);
+
+    static const TagFormat& detect(const char* head, size_t length);
+    static TrackMetadata read(const std::string& filename,
+                              unsigned fields = TrackMetadata::AllFields);
+};
@@ -0,0 +1,55 @@
+#include "TagText.h"
+
+namespace {
+
+const char* const kGenres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+    "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+    "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+    "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+    "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+    "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychadelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+    "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock",
+};
+
+}
+
+int leadingInt(const std::string& s, size_t& pos)
+{
+    int n = 0;
+    while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && n < 100000)
+        n = n * 10 + (s[pos++] - '0');
+    return n;
+}
+
+void numberPair(const std::string& s, int& number, int& count)
+{
+    size_t pos = 0;
+    number = leadingInt(s, pos);
+    count = 0;
+    if (pos < s.size() && s[pos] == '/') {
+        ++pos;
+        count = leadingInt(s, pos);
+    }
+}
+
+std::string id3v1Genre(size_t index)
+{
+    return index < sizeof(kGenres) / sizeof(kGenres[0]) ? kGenres[index] : "";
+}
+
+std::string tagString(const char* data, size_t size)
+{
+    size_t end = 0;
+    while (end < size && data[end] != '\0')
+        ++end;
+    size_t start = 0;
+    while (start < end && data[start] == ' ')
+        ++start;
+    while (end > start && data[end - 1] == ' ')
+        --end;
+    return std::string(data + start, end - start);
+}
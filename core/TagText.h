@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Small parsing helpers shared by the tag readers
+
+// Text up to the first NUL, without surrounding spaces
+std::string tagString(const char* data, size_t size);
+// Leading decimal number, 0 if there is none; pos is left after it
+int leadingInt(const std::string& s, size_t& pos);
+// "3" or "3/12"
+void numberPair(const std::string& s, int& number, int& count);
+// Name for an ID3v1 genre number, "" when out of range
+std::string id3v1Genre(size_t index);
+
+inline uint32_t littleEndian32(const char* p)
+{
+    return uint32_t((unsigned char)p[0]) | (uint32_t((unsigned char)p[1]) << 8) |
+           (uint32_t((unsigned char)p[2]) << 16) | (uint32_t((unsigned char)p[3]) << 24);
+}
+
+inline uint64_t littleEndian64(const char* p)
+{
+    return uint64_t(littleEndian32(p)) | (uint64_t(littleEndian32(p + 4)) << 32);
+}
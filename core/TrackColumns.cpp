@@ -0,0 +1,47 @@
+#include "TrackColumns.h"
+#include "Collation.h"
+
+uint32_t TrackColumns::Dictionary::intern(std::string key)
+{
+    auto it = ids.try_emplace(std::move(key), uint32_t(keys.size())).first;
+    if (it->second == keys.size())
+        keys.push_back(it->first);
+    return it->second;
+}
+
+uint32_t TrackColumns::Dictionary::find(const std::string& key) const
+{
+    auto it = ids.find(key);
+    return it == ids.end() ? kNoName : it->second;
+}
+
+void TrackColumns::set(TrackId id, const Track& track)
+{
+    if (id >= rows()) {
+        const size_t n = size_t(id) + 1;
+        lengths.resize(n, 0);
+        years.resize(n, 0);
+        numbers.resize(n, 0);
+        plays.resize(n, 0);
+        skips.resize(n, 0);
+        artists.resize(n, kNoName);
+        albums.resize(n, kNoName);
+        liveRows.resize(n);
+    }
+
+    lengths[id] = track.lengthSeconds;
+    years[id] = track.year;
+    numbers[id] = track.trackNumber;
+    plays[id] = skips[id] = 0;
+    artists[id] = artistNames.intern(collationKey(track.artist));
+    albums[id] = albumNames.intern(collationKey(track.album));
+    liveRows.set(id);
+}
+
+void TrackColumns::clear(TrackId id)
+{
+    lengths[id] = years[id] = numbers[id] = 0;
+    plays[id] = skips[id] = 0;
+    artists[id] = albums[id] = kNoName;
+    liveRows.reset(id);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Bitset.h"
+#include "Playlist.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The queryable track fields stored column by column, indexed by TrackId.
+// Track records are scattered across the heap and carry their strings.
+// A filter that looks at one or two fields of every track instead reads
+// these contiguous arrays, so it touches only the bytes it needs and its
+// loops vectorize.
+//
+// Artists and albums are stored as small integer ids from a dictionary
+// keyed by collation key, so "artist = X" compares integers. Like
+// GroupIndex, case and spacing variants of a name get the same id.
+// Dictionary entries are never removed.
+//
+// Kept up to date by TrackStore. Rows of freed ids are cleared and left
+// out of live().
+class TrackColumns {
+public:
+    // No artist or album has this id
+    static constexpr uint32_t kNoName = UINT32_MAX;
+
+    void set(TrackId id, const Track& track);
+    void clear(TrackId id);
+    void countPlay(TrackId id) { plays[id]++; }
+    void setPlays(TrackId id, uint32_t count) { plays[id] = count; }
+    void countSkip(TrackId id) { skips[id]++; }
+    void setSkips(TrackId id, uint32_t count) { skips[id] = count; }
+
+    // One row per id handed out so far
+    size_t rows() const { return lengths.size(); }
+    // Ids that hold a track
+    const Bitset& live() const { return liveRows; }
+
+    const std::vector<int32_t>& lengthSeconds() const { return lengths; }
+    const std::vector<int32_t>& year() const { return years; }
+    const std::vector<int32_t>& trackNumber() const { return numbers; }
+    const std::vector<uint32_t>& playCount() const { return plays; }
+    const std::vector<uint32_t>& skipCount() const { return skips; }
+    const std::vector<uint32_t>& artistId() const { return artists; }
+    const std::vector<uint32_t>& albumId() const { return albums; }
+
+    // Dictionaries: collation key by id, and id by collation key (kNoName
+    // when no track ever had it)
+    const std::vector<std::string>& artistKeys() const { return artistNames.keys; }
+    const std::vector<std::string>& albumKeys() const { return albumNames.keys; }
+    uint32_t findArtist(const std::string& key) const { return artistNames.find(key); }
+    uint32_t findAlbum(const std::string& key) const { return albumNames.find(key); }
+
+private:
+    struct Dictionary {
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string> keys;
+
+        uint32_t intern(std::string key);
+        uint32_t find(const std::string& key) const;
+    };
+
+    std::vector<int32_t> lengths;
+    std::vector<int32_t> years;
+    std::vector<int32_t> numbers;
+    std::vector<uint32_t> plays;
+    std::vector<uint32_t> skips;
+    std::vector<uint32_t> artists;
+    std::vector<uint32_t> albums;
+    Bitset liveRows;
+
+    Dictionary artistNames;
+    Dictionary albumNames;
+};
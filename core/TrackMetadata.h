@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+// Tags read from an audio file, whatever its format
+struct TrackMetadata {
+    // What a caller wants filled in. Readers skip everything else without
+    // decoding it and stop reading as soon as every wanted field has
+    // turned up.
+    enum Field : unsigned {
+        Title = 1 << 0,
+        Artist = 1 << 1,
+        Album = 1 << 2,
+        Length = 1 << 3,
+        TrackNumber = 1 << 4, // number and count
+        Disc = 1 << 5,        // number and count
+        Year = 1 << 6,
+        Genre = 1 << 7,
+
+        // What a playlist Track holds
+        TrackFields = Title | Artist | Album | Length | TrackNumber | Year,
+        AllFields = (1 << 8) - 1
+    };
+
+    std::string title = "Unknown Title";
+    std::string artist = "Unknown Artist";
+    std::string album = "Unknown Album";
+    int lengthSeconds = 0; // 0 when unknown
+    int trackNumber = 0;   // "3/12": 3 of 12; 0 when unknown
+    int trackCount = 0;
+    int discNumber = 0;    // same form
+    int discCount = 0;
+    int year = 0;
+    std::string genre;
+};
@@ -0,0 +1,443 @@
+#include "TrackQuery.h"
+#include "Collation.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Rows evaluated together: a block of every column a query reads, and its
+// stack of partial results, stays in L1
+constexpr size_t kBlockWords = 16;
+constexpr size_t kBlockRows = kBlockWords * 64;
+
+// Moves byte k (0 or 1) of a word to bit k of its top byte
+constexpr uint64_t kGatherBits = 0x0102040810204080ull;
+
+// 64 bytes of 0 or 1 to the bits of one word, eight at a time
+inline uint64_t packWord(const uint8_t* match)
+{
+    uint64_t bits = 0;
+    for (size_t b = 0; b < 8; ++b) {
+        uint64_t eight;
+        std::memcpy(&eight, match + b * 8, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        eight = __builtin_bswap64(eight);
+#endif
+        bits |= ((eight * kGatherBits) >> 56) << (8 * b);
+    }
+    return bits;
+}
+
+// out[w] bit j = pred(values[64 * w + j]) for n values. The comparisons
+// go to a byte array first, in fixed-length loops that compilers
+// vectorize, and are then packed into words.
+template <typename T, typename Pred>
+void packMatches(const T* values, size_t n, Pred pred, uint64_t* out)
+{
+    uint8_t match[64];
+    size_t w = 0;
+    for (; (w + 1) * 64 <= n; ++w) {
+        const T* v = values + w * 64;
+        for (size_t j = 0; j < 64; ++j)
+            match[j] = pred(v[j]);
+        out[w] = packWord(match);
+    }
+
+    if (w * 64 < n) {
+        std::fill(match, match + 64, uint8_t(0));
+        for (size_t j = 0; w * 64 + j < n; ++j)
+            match[j] = pred(values[w * 64 + j]);
+        out[w] = packWord(match);
+    }
+}
+
+// compare is TrackQuery::Compare; Contains is handled by the caller
+template <typename T, typename Compare>
+void compareNumbers(const T* values, size_t n, Compare compare, int64_t x, uint64_t* out)
+{
+    // A value the column cannot hold compares the same way with every row
+    if (x < int64_t(std::numeric_limits<T>::min()) || x > int64_t(std::numeric_limits<T>::max())) {
+        const bool above = x > 0;
+        const bool all = compare == Compare::Ne
+            || (above ? compare == Compare::Lt || compare == Compare::Le
+                      : compare == Compare::Gt || compare == Compare::Ge);
+        std::fill(out, out + (n + 63) / 64, all ? ~uint64_t(0) : 0);
+        return;
+    }
+
+    const T y = T(x);
+    switch (compare) {
+    case Compare::Eq: packMatches(values, n, [y](T v) { return v == y; }, out); break;
+    case Compare::Ne: packMatches(values, n, [y](T v) { return v != y; }, out); break;
+    case Compare::Lt: packMatches(values, n, [y](T v) { return v < y; }, out); break;
+    case Compare::Le: packMatches(values, n, [y](T v) { return v <= y; }, out); break;
+    case Compare::Gt: packMatches(values, n, [y](T v) { return v > y; }, out); break;
+    case Compare::Ge: packMatches(values, n, [y](T v) { return v >= y; }, out); break;
+    default: break;
+    }
+}
+
+bool isWordChar(char c)
+{
+    return !std::isspace((unsigned char)c) && c != '(' && c != ')' && c != '"'
+        && c != '=' && c != '!' && c != '<' && c != '>' && c != '~';
+}
+
+std::string lower(std::string s)
+{
+    for (char& c : s)
+        c = char(std::tolower((unsigned char)c));
+    return s;
+}
+
+// Digits only, or colon-separated minutes / hours when clock is set
+bool parseNumber(const std::string& text, bool clock, int64_t& out)
+{
+    int64_t value = 0;
+    size_t parts = 0;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(':', start);
+        if (end == std::string::npos)
+            end = text.size();
+        if (end == start || end - start > 12 || ++parts > (clock ? 3u : 1u))
+            return false;
+        int64_t part = 0;
+        for (size_t i = start; i < end; ++i) {
+            if (!std::isdigit((unsigned char)text[i]))
+                return false;
+            part = part * 10 + (text[i] - '0');
+        }
+        if (parts > 1 && part >= 60)
+            return false;
+        value = value * 60 + part;
+        start = end + 1;
+    }
+    out = value;
+    return true;
+}
+
+// Parentheses and "not"s open inside one another; the parser recurses
+// once per level, so the stack bounds how deep a query may go
+constexpr size_t kMaxNesting = 256;
+
+}
+
+struct TrackQuery::Parser {
+    enum class Token { Word, String, Symbol, Open, Close, End };
+
+    Parser(const std::string& text, std::string& error, TrackQuery& query)
+        : text(text),
+        error(error),
+        query(query)
+    {
+    }
+
+    const std::string& text;
+    std::string& error;
+    TrackQuery& query;
+    size_t pos = 0;
+
+    Token token = Token::End;
+    std::string value;
+    size_t nesting = 0;
+
+    bool fail(const std::string& message)
+    {
+        if (error.empty())
+            error = message;
+        return false;
+    }
+
+    std::string shown() const
+    {
+        return token == Token::End ? "end of query" : "'" + value + "'";
+    }
+
+    bool advance()
+    {
+        while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+            ++pos;
+        value.clear();
+        if (pos == text.size()) {
+            token = Token::End;
+            return true;
+        }
+
+        const char c = text[pos];
+        if (c == '(' || c == ')') {
+            token = c == '(' ? Token::Open : Token::Close;
+            value = c;
+            ++pos;
+        } else if (c == '"') {
+            token = Token::String;
+            for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+                if (text[pos] == '\\' && pos + 1 < text.size())
+                    ++pos;
+                value += text[pos];
+            }
+            if (pos == text.size())
+                return fail("unterminated string");
+            ++pos;
+        } else if (!isWordChar(c)) {
+            token = Token::Symbol;
+            value = c;
+            ++pos;
+            if (pos < text.size() && text[pos] == '=' && c != '=' && c != '~')
+                value += text[pos++];
+        } else {
+            token = Token::Word;
+            while (pos < text.size() && isWordChar(text[pos]))
+                value += text[pos++];
+        }
+        return true;
+    }
+
+    bool keyword(const char* word) const
+    {
+        return token == Token::Word && lower(value) == word;
+    }
+
+    void emit(OpKind kind)
+    {
+        Op op;
+        op.kind = kind;
+        query.program.push_back(std::move(op));
+    }
+
+    bool parseOr()
+    {
+        if (!parseAnd())
+            return false;
+        while (keyword("or")) {
+            if (!advance() || !parseAnd())
+                return false;
+            emit(OpKind::Or);
+        }
+        return true;
+    }
+
+    bool parseAnd()
+    {
+        if (!parseUnary())
+            return false;
+        while (keyword("and")) {
+            if (!advance() || !parseUnary())
+                return false;
+            emit(OpKind::And);
+        }
+        return true;
+    }
+
+    bool parseUnary()
+    {
+        if (keyword("not") || token == Token::Open) {
+            if (++nesting > kMaxNesting)
+                return fail("query nested too deeply");
+            const bool ok = parseNested();
+            --nesting;
+            return ok;
+        }
+        return parseTest();
+    }
+
+    // "not x" or "(x)"
+    bool parseNested()
+    {
+        if (keyword("not")) {
+            if (!advance() || !parseUnary())
+                return false;
+            emit(OpKind::Not);
+            return true;
+        }
+        if (!advance() || !parseOr())
+            return false;
+        if (token != Token::Close)
+            return fail("expected ')' instead of " + shown());
+        return advance();
+    }
+
+    bool parseTest()
+    {
+        if (token != Token::Word)
+            return fail("expected a field name instead of " + shown());
+
+        Op op;
+        op.kind = OpKind::Test;
+        const std::string field = lower(value);
+        if (field == "artist")      op.column = Column::Artist;
+        else if (field == "album")  op.column = Column::Album;
+        else if (field == "length") op.column = Column::Length;
+        else if (field == "year")   op.column = Column::Year;
+        else if (field == "track")  op.column = Column::TrackNumber;
+        else if (field == "plays")  op.column = Column::Plays;
+        else if (field == "skips")  op.column = Column::Skips;
+        else return fail("unknown field '" + value + "'");
+        const bool names = op.column == Column::Artist || op.column == Column::Album;
+
+        if (!advance())
+            return false;
+        if (token != Token::Symbol)
+            return fail("expected a comparison after '" + field + "'");
+        if (value == "=")       op.compare = Compare::Eq;
+        else if (value == "!=") op.compare = Compare::Ne;
+        else if (value == "<")  op.compare = Compare::Lt;
+        else if (value == "<=") op.compare = Compare::Le;
+        else if (value == ">")  op.compare = Compare::Gt;
+        else if (value == ">=") op.compare = Compare::Ge;
+        else if (value == "~")  op.compare = Compare::Contains;
+        else return fail("unknown comparison '" + value + "'");
+        if (names && op.compare != Compare::Eq && op.compare != Compare::Ne && op.compare != Compare::Contains)
+            return fail("'" + field + "' takes =, != or ~");
+        if (!names && op.compare == Compare::Contains)
+            return fail("'~' only applies to artist and album");
+
+        const std::string comparison = value;
+        if (!advance())
+            return false;
+        if (token != Token::Word && token != Token::String)
+            return fail("expected a value after '" + field + " " + comparison + "'");
+        if (names)
+            op.name = collationKey(value);
+        else if (token != Token::Word || !parseNumber(value, op.column == Column::Length, op.number))
+            return fail("bad " + std::string(op.column == Column::Length ? "length" : "number") + " '" + value + "'");
+
+        query.program.push_back(std::move(op));
+        return advance();
+    }
+};
+
+bool TrackQuery::parse(const std::string& text, TrackQuery& out, std::string& error)
+{
+    TrackQuery query;
+    query.source = text;
+    error.clear();
+    Parser parser(text, error, query);
+
+    if (!parser.advance())
+        return false;
+    if (parser.token == Parser::Token::End)
+        return parser.fail("empty query");
+    if (!parser.parseOr())
+        return false;
+    if (parser.token != Parser::Token::End)
+        return parser.fail("unexpected " + parser.shown());
+
+    // Stack slots the program needs
+    size_t height = 0;
+    for (const Op& op : query.program) {
+        if (op.kind == OpKind::Test)
+            query.depth = std::max(query.depth, ++height);
+        else if (op.kind != OpKind::Not)
+            --height;
+    }
+
+    out = std::move(query);
+    return true;
+}
+
+Bitset TrackQuery::evaluate(const TrackColumns& columns) const
+{
+    const size_t rows = columns.rows();
+    Bitset result(rows);
+    if (program.empty())
+        return result;
+
+    // Names to dictionary ids, looked up again on every run since tracks
+    // come and go between runs
+    std::vector<uint32_t> nameIds(program.size(), TrackColumns::kNoName);
+    std::vector<Bitset> nameSets(program.size());
+    for (size_t i = 0; i < program.size(); ++i) {
+        const Op& op = program[i];
+        if (op.kind != OpKind::Test || (op.column != Column::Artist && op.column != Column::Album))
+            continue;
+        const bool artist = op.column == Column::Artist;
+        if (op.compare != Compare::Contains) {
+            nameIds[i] = artist ? columns.findArtist(op.name) : columns.findAlbum(op.name);
+            continue;
+        }
+        const std::vector<std::string>& keys = artist ? columns.artistKeys() : columns.albumKeys();
+        nameSets[i].resize(keys.size());
+        for (size_t k = 0; k < keys.size(); ++k) {
+            if (keys[k].find(op.name) != std::string::npos)
+                nameSets[i].set(k);
+        }
+    }
+
+    std::vector<uint64_t> stack(depth * kBlockWords);
+    for (size_t base = 0; base < rows; base += kBlockRows) {
+        const size_t n = std::min(kBlockRows, rows - base);
+        const size_t words = (n + 63) / 64;
+        size_t height = 0;
+
+        for (size_t i = 0; i < program.size(); ++i) {
+            const Op& op = program[i];
+            uint64_t* top = stack.data() + height * kBlockWords;
+
+            switch (op.kind) {
+            case OpKind::Test:
+                switch (op.column) {
+                case Column::Length:
+                    compareNumbers(columns.lengthSeconds().data() + base, n, op.compare, op.number, top);
+                    break;
+                case Column::Year:
+                    compareNumbers(columns.year().data() + base, n, op.compare, op.number, top);
+                    break;
+                case Column::TrackNumber:
+                    compareNumbers(columns.trackNumber().data() + base, n, op.compare, op.number, top);
+                    break;
+                case Column::Plays:
+                    compareNumbers(columns.playCount().data() + base, n, op.compare, op.number, top);
+                    break;
+                case Column::Skips:
+                    compareNumbers(columns.skipCount().data() + base, n, op.compare, op.number, top);
+                    break;
+                case Column::Artist:
+                case Column::Album: {
+                    const uint32_t* ids = (op.column == Column::Artist ? columns.artistId() : columns.albumId()).data() + base;
+                    if (op.compare == Compare::Contains) {
+                        const Bitset& set = nameSets[i];
+                        packMatches(ids, n, [&set](uint32_t id) { return id < set.size() && set.test(id); }, top);
+                    } else {
+                        compareNumbers(ids, n, op.compare, int64_t(nameIds[i]), top);
+                    }
+                    break;
+                }
+                }
+                ++height;
+                break;
+            case OpKind::And:
+            case OpKind::Or: {
+                uint64_t* lhs = stack.data() + (height - 2) * kBlockWords;
+                const uint64_t* rhs = lhs + kBlockWords;
+                if (op.kind == OpKind::And) {
+                    for (size_t w = 0; w < words; ++w)
+                        lhs[w] &= rhs[w];
+                } else {
+                    for (size_t w = 0; w < words; ++w)
+                        lhs[w] |= rhs[w];
+                }
+                --height;
+                break;
+            }
+            case OpKind::Not: {
+                uint64_t* operand = stack.data() + (height - 1) * kBlockWords;
+                for (size_t w = 0; w < words; ++w)
+                    operand[w] = ~operand[w];
+                break;
+            }
+            }
+        }
+
+        // Freed ids never match
+        const uint64_t* live = columns.live().words() + base / 64;
+        uint64_t* out = result.words() + base / 64;
+        for (size_t w = 0; w < words; ++w)
+            out[w] = stack[w] & live[w];
+    }
+    return result;
+}
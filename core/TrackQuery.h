@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Bitset.h"
+#include "TrackColumns.h"
+
+#include <string>
+#include <vector>
+
+// Smart playlist filter, e.g.
+//
+//   artist = "Radiohead" and length > 5:00 and not album = "OK Computer"
+//
+// A query is comparisons joined with and / or / not and grouped with
+// parentheses; "and" binds tighter than "or". Fields:
+//
+//   artist, album           = != ~ (contains)   "quoted" or a bare word
+//   length                  = != < <= > >=      seconds, m:ss or h:mm:ss
+//   year, track             = != < <= > >=      whole numbers
+//   plays, skips            = != < <= > >=      whole numbers
+//
+// Names are matched by collation key, so case, spacing and a leading
+// "the" do not matter. Keywords and field names are case-insensitive.
+//
+// parse() compiles the text into a postfix program over TrackColumns.
+// evaluate() runs it a block of rows at a time: each comparison is one
+// branch-free pass over a contiguous column that packs its results into
+// bitset words, and and / or / not combine whole words. A few predicates
+// over a million tracks take milliseconds.
+class TrackQuery {
+public:
+    // False with a message in error when text is not a valid query
+    static bool parse(const std::string& text, TrackQuery& out, std::string& error);
+
+    const std::string& text() const { return source; }
+
+    // Ids of the live tracks that match
+    Bitset evaluate(const TrackColumns& columns) const;
+
+private:
+    enum class Column { Length, Year, TrackNumber, Plays, Skips, Artist, Album };
+    enum class Compare { Eq, Ne, Lt, Le, Gt, Ge, Contains };
+    enum class OpKind { Test, And, Or, Not };
+
+    struct Op {
+        OpKind kind;
+        Column column = Column::Length;
+        Compare compare = Compare::Eq;
+        int64_t number = 0;
+        std::string name; // collation key, for artist / album
+    };
+
+    struct Parser;
+
+    std::vector<Op> program;
+    size_t depth = 0; // stack slots evaluate() needs
+    std::string source;
+};
@@ -0,0 +1,70 @@
+#include "TrackStore.h"
+#include "MemoryStats.h"
+
+TrackId TrackStore::add(const Track& track)
+{
+    MemoryScope scope(MemoryTag::Tracks);
+    TrackId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = TrackId(slots.size());
+        slots.emplace_back();
+    }
+
+    Slot& slot = slots[id];
+    slot.track = std::make_shared<const Track>(track);
+    slot.refs = 1;
+    slot.sequence = addCount++;
+    table.set(id, track);
+    live++;
+    return id;
+}
+
+void TrackStore::retain(TrackId id)
+{
+    slots[id].refs++;
+}
+
+void TrackStore::release(TrackId id)
+{
+    Slot& slot = slots[id];
+    if (--slot.refs > 0)
+        return;
+
+    slot.track.reset();
+    slot.collation.reset();
+    table.clear(id);
+    freeIds.push_back(id);
+    live--;
+}
+
+void TrackStore::update(TrackId id, const Track& track)
+{
+    MemoryScope scope(MemoryTag::Tracks);
+    Slot& slot = slots[id];
+    slot.track = std::make_shared<const Track>(track);
+    slot.collation.reset();
+
+    const uint32_t played = table.playCount()[id];
+    const uint32_t skipped = table.skipCount()[id];
+    table.set(id, track);
+    setCounts(id, played, skipped);
+    updateCount++;
+}
+
+void TrackStore::setCounts(TrackId id, uint32_t plays, uint32_t skips)
+{
+    table.setPlays(id, plays);
+    table.setSkips(id, skips);
+}
+
+const CollationKeys& TrackStore::collation(TrackId id)
+{
+    MemoryScope scope(MemoryTag::Collation);
+    Slot& slot = slots[id];
+    if (!slot.collation)
+        slot.collation = collationKeys(slot.track->title, slot.track->artist, slot.track->album);
+    return *slot.collation;
+}
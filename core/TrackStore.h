@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Collation.h"
+#include "Playlist.h"
+#include "TrackColumns.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Library-wide track metadata. A track is stored once however many
+// playlists include it: playlists refer to it by TrackId and each holds a
+// reference, so forking a playlist or building one from a selection only
+// copies ids. When the last reference goes the slot is freed and its id
+// recycled.
+//
+// Tracks are handed out as shared_ptr<const Track>, so a playlist snapshot
+// read on another thread stays valid after the store lets go of a track.
+// The store itself is single-threaded.
+class TrackStore {
+public:
+    // Stores a new track with one reference held by the caller
+    TrackId add(const Track& track);
+    void retain(TrackId id);
+    void release(TrackId id);
+    // Replaces a stored track's metadata, e.g. once its tags have been
+    // read. Playlists keep the old version until told (Library::update).
+    // The play and skip counts stay.
+    void update(TrackId id, const Track& track);
+
+    const std::shared_ptr<const Track>& get(TrackId id) const { return slots[id].track; }
+    uint32_t references(TrackId id) const { return slots[id].refs; }
+
+    // Sort keys, computed the first time a sort asks for them
+    const CollationKeys& collation(TrackId id);
+
+    // The same tracks column by column, for smart playlist queries
+    const TrackColumns& columns() const { return table; }
+    // Play and skip counts live only in the columns
+    void countPlay(TrackId id) { table.countPlay(id); }
+    void countSkip(TrackId id) { table.countSkip(id); }
+    uint32_t plays(TrackId id) const { return table.playCount()[id]; }
+    uint32_t skips(TrackId id) const { return table.skipCount()[id]; }
+    // Counts from earlier sessions (PlayStats)
+    void setCounts(TrackId id, uint32_t plays, uint32_t skips);
+
+    // Number of update() calls so far, so a playlist can tell whether an
+    // old snapshot may hold outdated tracks
+    uint64_t updates() const { return updateCount; }
+
+    // Tracks held by at least one playlist
+    size_t size() const { return live; }
+    // One past the largest id handed out so far
+    size_t idLimit() const { return slots.size(); }
+    // Grows with every add(); ids are recycled, so their order does not
+    // tell which track came first
+    uint64_t sequence(TrackId id) const { return slots[id].sequence; }
+
+private:
+    struct Slot {
+        std::shared_ptr<const Track> track;
+        std::optional<CollationKeys> collation;
+        uint32_t refs = 0;
+        uint64_t sequence = 0;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<TrackId> freeIds;
+    size_t live = 0;
+    uint64_t addCount = 0;
+    uint64_t updateCount = 0;
+    TrackColumns table;
+};
@@ -0,0 +1,52 @@
+#include "UpdateScheduler.h"
+
+#include <cstdlib>
+
+UpdateScheduler::UpdateScheduler(std::chrono::milliseconds interval)
+    : updateInterval(interval)
+{
+}
+
+std::chrono::milliseconds UpdateScheduler::intervalFromEnvironment(std::chrono::milliseconds fallback)
+{
+    const char* value = std::getenv("PLAYER_UI_INTERVAL_MS");
+    if (!value)
+        return fallback;
+
+    long ms = std::strtol(value, nullptr, 10);
+    return ms > 0 ? std::chrono::milliseconds(ms) : fallback;
+}
+
+void UpdateScheduler::setPositionResolution(int64_t ms)
+{
+    resolutionMs = ms > 0 ? ms : 1;
+    refreshDirty();
+}
+
+void UpdateScheduler::refreshDirty()
+{
+    if (dirty)
+        return;
+
+    dirty = latest.state != shown.state
+         || latest.durationMs / resolutionMs != shown.durationMs / resolutionMs
+         || latest.positionMs / resolutionMs != shown.positionMs / resolutionMs;
+}
+
+UpdateScheduler::Clock::duration UpdateScheduler::timeUntilDue(Clock::time_point now) const
+{
+    Clock::time_point due = lastUpdate + updateInterval;
+    return due > now ? due - now : Clock::duration::zero();
+}
+
+bool UpdateScheduler::poll(Clock::time_point now, Snapshot& out)
+{
+    if (!dirty || timeUntilDue(now) > Clock::duration::zero())
+        return false;
+
+    shown = latest;
+    dirty = false;
+    lastUpdate = now;
+    out = shown;
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Coalesces playback-state changes into at most one UI update per interval
+// (normally one display frame) and drops changes the user could not see,
+// e.g. a position tick that does not move the m:ss label or the slider.
+//
+// Frontends feed every change through the setters, then call poll() from
+// their timer or main loop and repaint only when it returns true.
+class UpdateScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State { Stopped, Playing, Paused, Buffering, Error };
+
+    struct Snapshot {
+        int64_t positionMs = 0;
+        int64_t durationMs = 0;
+        State state = State::Stopped;
+    };
+
+    explicit UpdateScheduler(std::chrono::milliseconds interval = std::chrono::milliseconds(16));
+
+    // PLAYER_UI_INTERVAL_MS overrides the frontend's default interval
+    static std::chrono::milliseconds intervalFromEnvironment(std::chrono::milliseconds fallback);
+
+    void setInterval(std::chrono::milliseconds value) { updateInterval = value; }
+    std::chrono::milliseconds interval() const { return updateInterval; }
+
+    // Smallest position change worth showing
+    void setPositionResolution(int64_t ms);
+
+    void setPosition(int64_t ms) { latest.positionMs = ms; refreshDirty(); }
+    void setDuration(int64_t ms) { latest.durationMs = ms; refreshDirty(); }
+    void setState(State state)   { latest.state = state;  refreshDirty(); }
+
+    // Forces the next poll() to report an update
+    void invalidate() { dirty = true; }
+
+    // True when a visible change is waiting to be shown
+    bool pending() const { return dirty; }
+
+    // Time until poll() may next return true; zero when it already may
+    Clock::duration timeUntilDue(Clock::time_point now) const;
+
+    // Returns true and fills out when a visible change is pending and the
+    // interval since the previous update has elapsed.
+    bool poll(Clock::time_point now, Snapshot& out);
+
+private:
+    void refreshDirty();
+
+    std::chrono::milliseconds updateInterval;
+    int64_t resolutionMs = 1000;
+
+    Snapshot latest;
+    Snapshot shown;
+    bool dirty = true;
+    Clock::time_point lastUpdate;
+};
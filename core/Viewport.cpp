@@ -0,0 +1,74 @@
+#include "Viewport.h"
+
+#include <algorithm>
+
+void Viewport::setHeight(size_t height)
+{
+    rows = std::max<size_t>(height, 1);
+    clamp();
+}
+
+void Viewport::setCount(size_t count)
+{
+    total = count;
+    clamp();
+}
+
+void Viewport::setCursor(size_t index)
+{
+    cursorRow = index;
+    clamp();
+}
+
+void Viewport::moveCursor(long delta)
+{
+    if (delta < 0)
+        cursorRow -= std::min(cursorRow, size_t(-delta));
+    else
+        cursorRow += size_t(delta);
+    clamp();
+}
+
+void Viewport::pageUp()
+{
+    const size_t step = std::min(top, rows);
+    top -= step;
+    cursorRow -= std::min(cursorRow, rows);
+    clamp();
+}
+
+void Viewport::pageDown()
+{
+    top += rows;
+    cursorRow += rows;
+    clamp();
+}
+
+void Viewport::reveal(size_t index)
+{
+    const bool wasVisible = visible(index);
+    cursorRow = index;
+    if (!wasVisible)
+        top = index > rows / 2 ? index - rows / 2 : 0;
+    clamp();
+}
+
+void Viewport::scrollToCursor()
+{
+    if (cursorRow < top)
+        top = cursorRow;
+    else if (cursorRow >= top + rows)
+        top = cursorRow - rows + 1;
+}
+
+void Viewport::clamp()
+{
+    if (total == 0) {
+        top = cursorRow = 0;
+        return;
+    }
+    cursorRow = std::min(cursorRow, total - 1);
+    // No empty space below the last row while there is more above
+    top = std::min(top, total > rows ? total - rows : 0);
+    scrollToCursor();
+}
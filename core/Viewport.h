@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+// Scroll position and cursor for a list shown a fixed number of rows at a
+// time. It only knows the list's length, never its contents, so every
+// operation is O(1) and a frontend draws just the rows in [first(), end())
+// however long the list is.
+//
+// The cursor always stays on screen: moving it scrolls the view as little
+// as possible, and resizing or shortening the list pulls both back in
+// range.
+class Viewport {
+public:
+    void setHeight(size_t rows);
+    void setCount(size_t count);
+
+    size_t height() const { return rows; }
+    size_t count() const { return total; }
+
+    // Visible rows are [first(), end())
+    size_t first() const { return top; }
+    size_t end() const { return top + rows < total ? top + rows : total; }
+    bool visible(size_t index) const { return index >= top && index < end(); }
+
+    size_t cursor() const { return cursorRow; }
+    void setCursor(size_t index);
+    void moveCursor(long delta);
+    // A screenful at a time; the cursor keeps its place on screen
+    void pageUp();
+    void pageDown();
+
+    // Puts the cursor on index, scrolled to the middle of the screen unless
+    // it is already visible (auto-scroll to the playing track)
+    void reveal(size_t index);
+
+private:
+    void scrollToCursor();
+    void clamp();
+
+    size_t rows = 1;
+    size_t total = 0;
+    size_t top = 0;
+    size_t cursorRow = 0;
+};
@@ -0,0 +1,92 @@
+#include "VorbisComment.h"
+#include "TagText.h"
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+// key is upper case; name is as found in the file
+bool keyIs(const char* name, size_t length, const char* key)
+{
+    if (std::strlen(key) != length)
+        return false;
+    for (size_t i = 0; i < length; ++i) {
+        char c = name[i];
+        if (c >= 'a' && c <= 'z')
+            c = char(c - 'a' + 'A');
+        if (c != key[i])
+            return false;
+    }
+    return true;
+}
+
+}
+
+unsigned parseVorbisComment(const char* data, size_t size, unsigned fields, TrackMetadata& meta)
+{
+    if (size < 4)
+        return 0;
+    size_t pos = 4 + size_t(littleEndian32(data));
+    if (pos + 4 > size)
+        return 0;
+    uint32_t count = littleEndian32(data + pos);
+    pos += 4;
+
+    unsigned found = 0;
+    // Totals can come as "3/12" or as separate keys; either way the first wins
+    int trackCount = 0;
+    int discCount = 0;
+    for (uint32_t i = 0; i < count && pos + 4 <= size; ++i) {
+        uint32_t length = littleEndian32(data + pos);
+        pos += 4;
+        if (length > size - pos)
+            break;
+        const char* comment = data + pos;
+        pos += length;
+
+        const char* equals = static_cast<const char*>(std::memchr(comment, '=', length));
+        if (!equals)
+            continue;
+        const size_t keyLength = size_t(equals - comment);
+        const std::string value = tagString(equals + 1, length - keyLength - 1);
+        auto wanted = [&](unsigned field) { return (fields & field) && !(found & field); };
+
+        size_t at = 0;
+        if (keyIs(comment, keyLength, "TITLE") && wanted(TrackMetadata::Title)) {
+            meta.title = value;
+            found |= TrackMetadata::Title;
+        } else if (keyIs(comment, keyLength, "ARTIST") && wanted(TrackMetadata::Artist)) {
+            meta.artist = value;
+            found |= TrackMetadata::Artist;
+        } else if (keyIs(comment, keyLength, "ALBUM") && wanted(TrackMetadata::Album)) {
+            meta.album = value;
+            found |= TrackMetadata::Album;
+        } else if (keyIs(comment, keyLength, "TRACKNUMBER") && wanted(TrackMetadata::TrackNumber)) {
+            numberPair(value, meta.trackNumber, meta.trackCount);
+            found |= TrackMetadata::TrackNumber;
+        } else if (keyIs(comment, keyLength, "TRACKTOTAL") || keyIs(comment, keyLength, "TOTALTRACKS")) {
+            if (!trackCount)
+                trackCount = leadingInt(value, at);
+        } else if (keyIs(comment, keyLength, "DISCNUMBER") && wanted(TrackMetadata::Disc)) {
+            numberPair(value, meta.discNumber, meta.discCount);
+            found |= TrackMetadata::Disc;
+        } else if (keyIs(comment, keyLength, "DISCTOTAL") || keyIs(comment, keyLength, "TOTALDISCS")) {
+            if (!discCount)
+                discCount = leadingInt(value, at);
+        } else if ((keyIs(comment, keyLength, "DATE") || keyIs(comment, keyLength, "YEAR"))
+                   && wanted(TrackMetadata::Year)) {
+            meta.year = leadingInt(value, at); // "2004" or "2004-05-01"
+            found |= TrackMetadata::Year;
+        } else if (keyIs(comment, keyLength, "GENRE") && wanted(TrackMetadata::Genre)) {
+            meta.genre = value;
+            found |= TrackMetadata::Genre;
+        }
+    }
+
+    if ((found & TrackMetadata::TrackNumber) && !meta.trackCount)
+        meta.trackCount = trackCount;
+    if ((found & TrackMetadata::Disc) && !meta.discCount)
+        meta.discCount = discCount;
+    return found;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "TrackMetadata.h"
+
+#include <cstddef>
+
+// Vorbis comment block, shared by Ogg Vorbis and FLAC: a vendor string and
+// then KEY=value pairs with case-insensitive keys. Fills the wanted fields
+// it finds (the first value wins when a key repeats) and returns them.
+unsigned parseVorbisComment(const char* data, size_t size, unsigned fields, TrackMetadata& meta);
@@ -0,0 +1,113 @@
+#include "WavReader.h"
+#include "TagText.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// INFO lists are small; anything bigger is taken to be corrupt
+constexpr uint32_t kMaxInfo = 1024 * 1024;
+
+bool idIs(const char* id, const char* expected)
+{
+    return std::memcmp(id, expected, 4) == 0;
+}
+
+// INFO sub-chunks: four-letter id, size, NUL-terminated text
+unsigned parseInfo(const char* data, size_t size, unsigned fields, TrackMetadata& meta)
+{
+    unsigned found = 0;
+    size_t pos = 0;
+    while (pos + 8 <= size) {
+        const char* id = data + pos;
+        const uint32_t length = littleEndian32(data + pos + 4);
+        pos += 8;
+        if (length > size - pos)
+            break;
+        const std::string value = tagString(data + pos, length);
+        pos += length + (length & 1);
+
+        size_t at = 0;
+        unsigned field = 0;
+        if (idIs(id, "INAM"))
+            field = TrackMetadata::Title;
+        else if (idIs(id, "IART"))
+            field = TrackMetadata::Artist;
+        else if (idIs(id, "IPRD"))
+            field = TrackMetadata::Album;
+        else if (idIs(id, "ITRK") || idIs(id, "IPRT"))
+            field = TrackMetadata::TrackNumber;
+        else if (idIs(id, "ICRD"))
+            field = TrackMetadata::Year;
+        else if (idIs(id, "IGNR"))
+            field = TrackMetadata::Genre;
+        field &= fields & ~found;
+
+        switch (field) {
+        case TrackMetadata::Title:       meta.title = value; break;
+        case TrackMetadata::Artist:      meta.artist = value; break;
+        case TrackMetadata::Album:       meta.album = value; break;
+        case TrackMetadata::TrackNumber: numberPair(value, meta.trackNumber, meta.trackCount); break;
+        case TrackMetadata::Year:        meta.year = leadingInt(value, at); break;
+        case TrackMetadata::Genre:       meta.genre = value; break;
+        }
+        found |= field;
+    }
+    return found;
+}
+
+}
+
+bool WavReader::sniff(const char* head, size_t length)
+{
+    return length >= 12 && idIs(head, "RIFF") && idIs(head + 8, "WAVE");
+}
+
+TrackMetadata WavReader::read(std::istream& file, unsigned fields)
+{
+    TrackMetadata meta;
+    char riff[12];
+    if (!file.read(riff, 12) || !sniff(riff, 12))
+        return meta;
+
+    const bool needLength = fields & TrackMetadata::Length;
+    bool needInfo = fields & ~TrackMetadata::Length;
+    uint32_t byteRate = 0;
+    uint64_t dataSize = 0;
+    bool haveData = false;
+
+    char header[8];
+    while ((needInfo || (needLength && (!byteRate || !haveData))) && file.read(header, 8)) {
+        const uint32_t size = littleEndian32(header + 4);
+        const std::streamoff padded = std::streamoff(size) + (size & 1);
+
+        if (idIs(header, "fmt ") && size >= 16) {
+            char format[16];
+            if (!file.read(format, 16))
+                break;
+            byteRate = littleEndian32(format + 8);
+            file.seekg(padded - 16, std::ios::cur);
+        } else if (idIs(header, "data")) {
+            dataSize = size;
+            haveData = true;
+            file.seekg(padded, std::ios::cur);
+        } else if (idIs(header, "LIST") && needInfo && size >= 4 && size <= kMaxInfo) {
+            std::vector<char> list(size);
+            if (!file.read(list.data(), size))
+                break;
+            if (idIs(list.data(), "INFO")) {
+                parseInfo(list.data() + 4, size - 4, fields, meta);
+                needInfo = false;
+            }
+            file.seekg(padded - size, std::ios::cur);
+        } else {
+            file.seekg(padded, std::ios::cur);
+        }
+    }
+
+    if (needLength && byteRate && haveData)
+        meta.lengthSeconds = int(dataSize / byteRate);
+    return meta;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "TrackMetadata.h"
+
+#include <cstddef>
+#include <istream>
+
+// Native RIFF/WAVE: the length from the fmt chunk's byte rate and the size
+// of the data chunk, tags from a LIST/INFO chunk. Chunks are visited by
+// their headers alone; the samples are seeked over, never read.
+class WavReader {
+public:
+    static bool sniff(const char* head, size_t length);
+    // file is positioned at its start
+    static TrackMetadata read(std::istream& file, unsigned fields);
+};
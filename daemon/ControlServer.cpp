@@ -0,0 +1,258 @@
+#include "ControlServer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Longest accepted command line; anything longer is a broken client
+constexpr size_t kMaxLine = 64 * 1024;
+// Replies queued for one client before its commands stop being read. A
+// single reply may go past it; the next command waits until it drains.
+constexpr size_t kMaxBacklog = 1024 * 1024;
+
+}
+
+ControlServer::ControlServer(Handler handler)
+    : handler(std::move(handler)),
+    epollFd(epoll_create1(EPOLL_CLOEXEC))
+{
+}
+
+ControlServer::~ControlServer()
+{
+    for (auto& entry : clients)
+        ::close(entry.first);
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        unlink(socketPath.c_str());
+    }
+    if (epollFd >= 0)
+        ::close(epollFd);
+}
+
+bool ControlServer::listen(const std::string& path, std::string& error)
+{
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "socket path too long: " + path;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+
+    unlink(path.c_str());
+    mode_t oldMask = umask(077); // owner-only socket
+    int rc = bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    umask(oldMask);
+    if (rc < 0 || ::listen(listenFd, SOMAXCONN) < 0) {
+        error = path + ": " + std::strerror(errno);
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    return true;
+}
+
+void ControlServer::watch(int fd, std::function<void()> onReady)
+{
+    watchers[fd] = std::move(onReady);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void ControlServer::run()
+{
+    epoll_event events[64];
+    running = true;
+
+    while (running) {
+        int n = epoll_wait(epollFd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < n && running; ++i) {
+            int fd = events[i].data.fd;
+
+            if (fd == listenFd) {
+                accept();
+                continue;
+            }
+
+            auto watcher = watchers.find(fd);
+            if (watcher != watchers.end()) {
+                watcher->second();
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP))
+                readFrom(fd);
+            if (!clients.count(fd))
+                continue;
+            if (events[i].events & (EPOLLHUP | EPOLLERR))
+                close(fd);
+            else if (events[i].events & EPOLLOUT)
+                flush(fd);
+        }
+    }
+
+    // Best effort: hand out replies still queued when stop() was called
+    std::vector<int> pending;
+    for (auto& entry : clients)
+        pending.push_back(entry.first);
+    for (int fd : pending)
+        flush(fd);
+}
+
+void ControlServer::accept()
+{
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return; // EAGAIN: drained the backlog
+
+        Client& client = clients[fd];
+        client.events = EPOLLIN | EPOLLRDHUP;
+        epoll_event ev{};
+        ev.events = client.events;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void ControlServer::readFrom(int fd)
+{
+    Client& client = clients[fd];
+    char buffer[16 * 1024];
+    bool closed = false;
+
+    // Stops early once the replies back up; the rest stays in the socket
+    // until flush() has sent enough of them
+    while (client.out.size() < kMaxBacklog) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            client.in.append(buffer, n);
+            handleLines(client);
+            // With room left every complete line was handled, so what
+            // remains is the start of one line
+            if (client.out.size() < kMaxBacklog && client.in.size() > kMaxLine) {
+                client.in.clear();
+                client.out += "err line too long\n";
+                closed = true;
+                break;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0 || errno != EAGAIN)
+            closed = true;
+        break;
+    }
+
+    // A client that shut down its write side still gets its replies
+    client.closing = client.closing || closed;
+    flush(fd);
+}
+
+void ControlServer::handleLines(Client& client)
+{
+    // Replies are queued in order
+    size_t start = 0;
+    while (client.out.size() < kMaxBacklog) {
+        size_t end = client.in.find('\n', start);
+        if (end == std::string::npos)
+            break;
+        size_t len = end - start;
+        if (len > 0 && client.in[end - 1] == '\r')
+            --len;
+        if (len > 0)
+            handler(client.in.substr(start, len), client.out);
+        start = end + 1;
+    }
+    client.in.erase(0, start);
+}
+
+void ControlServer::flush(int fd)
+{
+    Client& client = clients[fd];
+
+    for (;;) {
+        size_t sent = 0;
+        bool blocked = false;
+        while (sent < client.out.size()) {
+            ssize_t n = send(fd, client.out.data() + sent, client.out.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno != EAGAIN) {
+                close(fd);
+                return;
+            }
+            blocked = true;
+            break;
+        }
+        client.out.erase(0, sent);
+
+        // Lines read before the backlog filled up are handled once it has
+        // room again; the socket may hold nothing more to wake us for them
+        if (blocked || client.out.size() >= kMaxBacklog || client.in.find('\n') == std::string::npos)
+            break;
+        handleLines(client);
+    }
+
+    if (client.closing && client.out.empty()) {
+        close(fd);
+        return;
+    }
+
+    // Only ask for EPOLLOUT while a backlog is waiting, and stop reading
+    // from a client that already hung up its write side or is not reading
+    // its replies
+    const bool reading = !client.closing && client.out.size() < kMaxBacklog;
+    uint32_t events = reading ? uint32_t(EPOLLIN | EPOLLRDHUP) : 0u;
+    if (!client.out.empty())
+        events |= EPOLLOUT;
+    if (events != client.events) {
+        client.events = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+    }
+}
+
+void ControlServer::close(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    clients.erase(fd);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// Single-threaded epoll loop serving a line-based protocol on a Unix domain
+// socket. Clients may pipeline any number of commands: every complete line
+// in a read is handled in order and the replies go out in one write, so a
+// batch of thousands of commands costs a handful of syscalls. A client's
+// command line is capped at 64 KiB, and once 1 MiB of its replies is
+// queued its commands wait until it reads them.
+class ControlServer {
+public:
+    // Handles one command line and appends its reply (newline terminated)
+    using Handler = std::function<void(const std::string& line, std::string& reply)>;
+
+    explicit ControlServer(Handler handler);
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Binds and listens on path, replacing a stale socket file
+    bool listen(const std::string& path, std::string& error);
+
+    // Runs onReady on the loop thread whenever fd becomes readable
+    void watch(int fd, std::function<void()> onReady);
+
+    // Serves clients until stop() is called
+    void run();
+    void stop() { running = false; }
+
+private:
+    struct Client {
+        std::string in;
+        std::string out;
+        uint32_t events = 0;  // currently registered epoll interest
+        bool closing = false; // peer is done sending; close once out drains
+    };
+
+    void accept();
+    void readFrom(int fd);
+    // Handles the complete lines in client.in while the reply backlog has room
+    void handleLines(Client& client);
+    void flush(int fd);
+    void close(int fd);
+
+    Handler handler;
+    int epollFd = -1;
+    int listenFd = -1;
+    std::string socketPath;
+    bool running = false;
+
+    std::unordered_map<int, Client> clients;
+    std::unordered_map<int, std::function<void()>> watchers;
+};
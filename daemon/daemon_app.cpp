@@ -0,0 +1,304 @@
+#include <iostream>
+#include <string>
+
+#ifndef __linux__
+// The control loop is built on epoll
+int run_daemon(const std::string&) {
+    std::cerr << "Daemon mode is only supported on Linux." << std::endl;
+    return 1;
+}
+#else
+#include "Library.h"
+#include "MetadataLoader.h"
+#include "PlaylistImpl.h"
+#include "PlaybackController.h"
+#include "PlayStats.h"
+#include "TrackQuery.h"
+#include "ControlServer.h"
+#include "Prefetcher.h"
+#include "VlcBackend.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <random>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+namespace {
+
+std::string default_socket_path()
+{
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"))
+        return std::string(runtime) + "/player.sock";
+    return "/tmp/player-" + std::to_string(getuid()) + ".sock";
+}
+
+bool parse_number(const std::string& s, long long& out)
+{
+    if (s.empty())
+        return false;
+    char* end = nullptr;
+    out = std::strtoll(s.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+const char* state_name(PlaybackBackend::State state)
+{
+    switch (state) {
+        case PlaybackBackend::State::Buffering: return "buffering";
+        case PlaybackBackend::State::Playing:   return "playing";
+        case PlaybackBackend::State::Paused:    return "paused";
+        case PlaybackBackend::State::Error:     return "error";
+        default:                                return "stopped";
+    }
+}
+
+const char* repeat_name(PlaylistImpl::RepeatMode mode)
+{
+    switch (mode) {
+        case PlaylistImpl::RepeatMode::All: return "all";
+        case PlaylistImpl::RepeatMode::One: return "one";
+        default:                            return "off";
+    }
+}
+
+}
+
+int run_daemon(const std::string& requestedPath) {
+    const std::string socketPath = requestedPath.empty() ? default_socket_path() : requestedPath;
+
+    // SIGINT/SIGTERM arrive through the loop so the socket gets cleaned up.
+    // Blocked before any thread starts, so every thread inherits the mask
+    // and none of them takes the signal.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+    Library library;
+    PlaylistImpl& playlist = library.playlist(0);
+    Prefetcher prefetcher;
+
+    // Tags are read on the loader's thread; `add` replies at once with a
+    // placeholder row and the loop writes the tags in when woken
+    MetadataLoader loader;
+    int tagFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loader.setWakeup([tagFd]() {
+        uint64_t one = 1;
+        ssize_t ignored = write(tagFd, &one, sizeof(one));
+        (void)ignored;
+    });
+
+    PlayStats playStats;
+    std::string statsError;
+    if (!playStats.open(PlayStats::defaultDirectory(), statsError))
+        std::cerr << "play statistics: " << statsError << std::endl;
+
+    const char* vlc_args[] = {
+        "--no-video",
+        "--file-caching=5000",
+        "--no-interact"
+    };
+    VlcBackend backend(3, vlc_args);
+    if (!backend.ok()) {
+        std::cerr << "Failed to initialize libVLC." << std::endl;
+        return 1;
+    }
+
+    // Ends of tracks and state and duration changes arrive on a libvlc
+    // thread: wake the control loop, which polls the backend, so the
+    // controller sees them and advances like the frontends do
+    int playerFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    backend.setWakeup([playerFd]() {
+        uint64_t one = 1;
+        ssize_t ignored = write(playerFd, &one, sizeof(one));
+        (void)ignored;
+    });
+
+    PlaybackController playback(backend, &prefetcher);
+    playback.setPlaylist(&playlist);
+    playback.setPlayStats(&playStats);
+    PlaybackController::Hooks hooks;
+    hooks.trackStarted = [&](size_t, const Track&) { loader.follow(playlist); };
+    playback.setHooks(std::move(hooks));
+
+    ControlServer* server = nullptr;
+
+    auto handle = [&](const std::string& line, std::string& reply) {
+        size_t space = line.find(' ');
+        const std::string cmd = line.substr(0, space);
+        const std::string arg = space == std::string::npos ? "" : line.substr(space + 1);
+        long long n = 0;
+
+        if (cmd == "add") {
+            if (arg.empty()) { reply += "err missing path\n"; return; }
+            playlist.add(MetadataLoader::placeholder(arg));
+            const size_t index = playlist.size() - 1;
+            PlayStats::Entry counts = playStats.lookup(arg);
+            playlist.trackStore()->setCounts(playlist.idAt(index), counts.plays, counts.skips);
+            loader.enqueue(playlist, index, index + 1);
+            reply += "ok " + std::to_string(index) + "\n";
+        }
+        else if (cmd == "remove") {
+            if (!parse_number(arg, n) || n < 0 || size_t(n) >= playlist.size()) { reply += "err bad index\n"; return; }
+            if (playlist.currentIndex() == n)
+                playback.stop();
+            playlist.removeAt(size_t(n));
+            reply += "ok\n";
+        }
+        else if (cmd == "play") {
+            if (arg.empty()) {
+                playback.resume();
+                reply += "ok\n";
+                return;
+            }
+            if (!parse_number(arg, n) || n < 0 || !playback.play(size_t(n))) { reply += "err bad index\n"; return; }
+            reply += "ok\n";
+        }
+        else if (cmd == "pause") {
+            playback.pause();
+            reply += "ok\n";
+        }
+        else if (cmd == "stop") {
+            playback.stop();
+            reply += "ok\n";
+        }
+        else if (cmd == "next" || cmd == "prev") {
+            cmd == "next" ? playback.next() : playback.prev();
+            reply += "ok " + std::to_string(playlist.currentIndex()) + "\n";
+        }
+        else if (cmd == "seek") {
+            if (!parse_number(arg, n) || n < 0) { reply += "err bad position\n"; return; }
+            backend.seek(n);
+            reply += "ok\n";
+        }
+        else if (cmd == "shuffle") {
+            if (arg == "on") playlist.shuffle(std::random_device{}());
+            else if (arg == "off") playlist.disableShuffle();
+            else { reply += "err expected on|off\n"; return; }
+            reply += "ok\n";
+        }
+        else if (cmd == "repeat") {
+            if (arg == "off") playlist.setRepeatMode(PlaylistImpl::RepeatMode::Off);
+            else if (arg == "all") playlist.setRepeatMode(PlaylistImpl::RepeatMode::All);
+            else if (arg == "one") playlist.setRepeatMode(PlaylistImpl::RepeatMode::One);
+            else { reply += "err expected off|all|one\n"; return; }
+            reply += "ok\n";
+        }
+        else if (cmd == "sort") {
+            std::vector<SortKey> keys = defaultSortKeys();
+            if (!arg.empty() && !parseSortKeys(arg, keys)) { reply += "err bad sort keys\n"; return; }
+            playlist.sortBy(keys);
+            reply += "ok\n";
+        }
+        else if (cmd == "undo" || cmd == "redo") {
+            bool playingBefore = playlist.currentIndex() >= 0;
+            TrackId playing = playlist.idAt(size_t(playlist.currentIndex()));
+            if (!(cmd == "undo" ? playlist.undo() : playlist.redo())) { reply += "err nothing to " + cmd + "\n"; return; }
+            // Undoing the add of the playing track takes it off the list
+            if (playingBefore && playlist.indexOf(playing) < 0)
+                playback.stop();
+            reply += "ok " + std::to_string(playlist.size()) + "\n";
+        }
+        else if (cmd == "state") {
+            reply += "ok ";
+            reply += state_name(backend.state());
+            reply += " " + std::to_string(playlist.currentIndex());
+            reply += " " + std::to_string(backend.position());
+            reply += " " + std::to_string(backend.duration());
+            reply += " " + std::to_string(playlist.size());
+            reply += playlist.shuffled() ? " shuffle" : " ordered";
+            reply += " ";
+            reply += repeat_name(playlist.getRepeatMode());
+            reply += "\n";
+        }
+        else if (cmd == "prefetch") {
+            Prefetcher::Stats stats = prefetcher.stats();
+            reply += "ok " + std::to_string(stats.hits) + " " + std::to_string(stats.misses)
+                   + " " + std::to_string(stats.warmedFiles) + " " + std::to_string(stats.warmedBytes) + "\n";
+        }
+        else if (cmd == "list") {
+            // list [start [count]]: one "= ..." line per track, then "ok <count>"
+            size_t start = 0, count = playlist.size();
+            size_t sep = arg.find(' ');
+            if (!arg.empty()) {
+                if (!parse_number(arg.substr(0, sep), n) || n < 0) { reply += "err bad range\n"; return; }
+                start = size_t(n);
+                if (sep != std::string::npos) {
+                    if (!parse_number(arg.substr(sep + 1), n) || n < 0) { reply += "err bad range\n"; return; }
+                    count = size_t(n);
+                }
+            }
+            size_t end = std::min(playlist.size(), start + std::min(count, playlist.size()));
+            for (size_t i = start; i < end; ++i) {
+                Track t = playlist.at(i);
+                reply += "= " + std::to_string(i) + "\t" + t.filename + "\t" + t.title + "\t"
+                       + t.artist + "\t" + t.album + "\t" + std::to_string(t.lengthSeconds) + "\n";
+            }
+            reply += "ok " + std::to_string(end > start ? end - start : 0) + "\n";
+        }
+        else if (cmd == "query") {
+            // query <expr>: "= <index>" per matching track, then "ok <count>"
+            TrackQuery query;
+            std::string error;
+            if (!TrackQuery::parse(arg, query, error)) { reply += "err " + error + "\n"; return; }
+            const Bitset matches = query.evaluate(playlist.trackStore()->columns());
+            size_t count = 0, index = 0;
+            playlist.snapshot().forEach([&](const PlaylistImpl::Entry& e) {
+                if (matches.test(e.id)) {
+                    reply += "= " + std::to_string(index) + "\n";
+                    ++count;
+                }
+                ++index;
+            });
+            reply += "ok " + std::to_string(count) + "\n";
+        }
+        else if (cmd == "shutdown") {
+            reply += "ok\n";
+            server->stop();
+        }
+        else {
+            reply += "err unknown command\n";
+        }
+    };
+
+    ControlServer control(handle);
+    server = &control;
+
+    std::string error;
+    if (!control.listen(socketPath, error)) {
+        std::cerr << "player daemon: " << error << std::endl;
+        close(playerFd);
+        return 1;
+    }
+
+    control.watch(playerFd, [&]() {
+        uint64_t count;
+        if (read(playerFd, &count, sizeof(count)) > 0)
+            backend.poll();
+    });
+    control.watch(tagFd, [&]() {
+        uint64_t count;
+        if (read(tagFd, &count, sizeof(count)) > 0)
+            loader.apply(library);
+    });
+
+    int signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    control.watch(signalFd, [&]() { control.stop(); });
+
+    std::cerr << "player daemon listening on " << socketPath << std::endl;
+    control.run();
+
+    // Once stopped libvlc reports nothing more, so playerFd can go
+    backend.stop();
+    close(signalFd);
+    close(playerFd);
+    // tagFd stays open: the loader's thread may signal it until the
+    // loader is destroyed on the way out, and the process exits after
+
+    return 0;
+}
+#endif
+
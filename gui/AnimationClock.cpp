@@ -0,0 +1,32 @@
+#include "AnimationClock.h"
+#include <QGuiApplication>
+#include <QScreen>
+
+AnimationClock* AnimationClock::instance()
+{
+    static AnimationClock clock;
+    return &clock;
+}
+
+AnimationClock::AnimationClock()
+{
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &AnimationClock::tick);
+}
+
+void AnimationClock::subscribe()
+{
+    if (subscribers++ > 0)
+        return;
+
+    qreal hz = 60.0;
+    if (QScreen* screen = QGuiApplication::primaryScreen())
+        hz = screen->refreshRate() > 0 ? screen->refreshRate() : hz;
+    timer.start(qMax(1, qRound(1000.0 / hz)));
+}
+
+void AnimationClock::unsubscribe()
+{
+    if (subscribers > 0 && --subscribers == 0)
+        timer.stop();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <QObject>
+#include <QTimer>
+
+// One frame clock shared by every animated widget, paced at the primary
+// screen's refresh rate. It only runs while at least one subscriber is
+// visible, so a hidden or minimized window costs no wakeups.
+//
+// The pacing is a precise timer at the refresh interval, not the display's
+// vsync: ticks match the frame rate but drift against the actual frames.
+class AnimationClock : public QObject {
+    Q_OBJECT
+public:
+    static AnimationClock* instance();
+
+    void subscribe();
+    void unsubscribe();
+
+signals:
+    void tick();
+
+private:
+    AnimationClock();
+
+    QTimer timer;
+    int subscribers = 0;
+};
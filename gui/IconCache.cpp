@@ -0,0 +1,57 @@
+#include "IconCache.h"
+#include <QGuiApplication>
+#include <QHash>
+#include <QImage>
+#include <QPainter>
+#include <QPixmap>
+#include <QSvgRenderer>
+#include <QtMath>
+#include <iterator>
+
+namespace {
+
+const char* const kAtlasIcons[] = {
+    "play", "pause", "next", "previous", "shuffle", "repeat", "repeat-1"
+};
+
+QHash<QString, QIcon> buildAtlas()
+{
+    const qreal dpr = qApp ? qApp->devicePixelRatio() : 1.0;
+    const int side = qCeil(IconCache::kIconSize * dpr);
+    const int count = int(std::size(kAtlasIcons));
+
+    QImage atlas(side * count, side, QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+
+    QPainter painter(&atlas);
+    for (int i = 0; i < count; ++i) {
+        QSvgRenderer renderer(QString(":/icons/%1.svg").arg(kAtlasIcons[i]));
+        renderer.render(&painter, QRectF(i * side, 0, side, side));
+    }
+    painter.end();
+
+    QHash<QString, QIcon> icons;
+    const QPixmap sheet = QPixmap::fromImage(atlas);
+    for (int i = 0; i < count; ++i) {
+        QPixmap tile = sheet.copy(i * side, 0, side, side);
+        tile.setDevicePixelRatio(dpr);
+        icons.insert(kAtlasIcons[i], QIcon(tile));
+    }
+    return icons;
+}
+
+}
+
+QIcon IconCache::get(const QString& name)
+{
+    static QHash<QString, QIcon> icons = buildAtlas();
+
+    auto it = icons.constFind(name);
+    if (it != icons.constEnd())
+        return it.value();
+
+    // Not part of the atlas: load it the slow way, once
+    QIcon icon(QString(":/icons/%1.svg").arg(name));
+    icons.insert(name, icon);
+    return icon;
+}
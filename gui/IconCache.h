@@ -0,0 +1,13 @@
+#pragma once
+#include <QIcon>
+#include <QString>
+
+// Transport icons rasterized once from their SVGs into a single atlas.
+// Later lookups are a hash hit instead of an SVG parse per click.
+class IconCache {
+public:
+    static constexpr int kIconSize = 24;
+
+    // name is the file stem under :/icons, e.g. "pause"
+    static QIcon get(const QString& name);
+};
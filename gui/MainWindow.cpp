@@ -1,6 +1,10 @@
 #include "MainWindow.h"
-#include "Mp3Reader.h"
+#include "MemoryPanel.h"
+#include "MemoryStats.h"
+#include "PlaylistModel.h"
 #include "TrackIndicator.h"
+#include "IconCache.h"
+#include "StartupReport.h"
 
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -8,40 +12,156 @@
 #include <QFileInfo>
 #include <QUrl>
 #include <QHeaderView>
-#include <QEventLoop>
-#include <QResource>
-#include <QDirIterator>
+#include <QTreeWidget>
+#include <QScrollBar>
+#include <QSettings>
+#include <QTimer>
+#include <QCloseEvent>
+#include <QScreen>
+#include <QShortcut>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QAudioBuffer>
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QAudioBufferOutput>
+#endif
 #include <random>
 
 MainWindow::MainWindow(QWidget* parent)
     : QWidget(parent)
+{
+    uiTimer.setSingleShot(true);
+    uiTimer.setTimerType(Qt::PreciseTimer);
+    qreal hz = screen() && screen()->refreshRate() > 0 ? screen()->refreshRate() : 60.0;
+    uiScheduler.setInterval(UpdateScheduler::intervalFromEnvironment(
+        std::chrono::milliseconds(qMax(1, qRound(1000.0 / hz)))));
+
+    // Read the saved session and play statistics while the window is
+    // being built and shown; it is added once ready, never waited for here
+    connect(&pendingSession, &QFutureWatcher<Session>::finished, this, &MainWindow::restoreSession);
+    pendingSession.setFuture(QtConcurrent::run(&MainWindow::loadSession, &playStats));
+
+    setupUi();
+    StartupReport::mark("setup ui");
+    connectSignals();
+    StartupReport::mark("connect signals");
+
+    // Nothing below is needed to paint the first frame
+    QTimer::singleShot(0, this, &MainWindow::deferredInit);
+}
+
+void MainWindow::deferredInit()
 {
     audio.setVolume(0.5);
     player.setAudioOutput(&audio);
-    // Debug: Walk the entire resource tree
-    QDirIterator it(":", QDirIterator::Subdirectories);
-    qDebug() << "--- ALL REGISTERED RESOURCES ---";
-    while (it.hasNext()) {
-        qDebug() << it.next();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    // Tap decoded audio for the spectrum indicator
+    auto* bufferOutput = new QAudioBufferOutput(this);
+    player.setAudioBufferOutput(bufferOutput);
+    connect(bufferOutput, &QAudioBufferOutput::audioBufferReceived,
+            this, &MainWindow::feedSpectrum);
+#endif
+    StartupReport::mark("audio output");
+
+    deferredInitDone = true;
+    printStartupReportWhenDone();
+}
+
+MainWindow::~MainWindow()
+{
+    // The loader thread writes into playStats
+    pendingSession.waitForFinished();
+}
+
+void MainWindow::printStartupReportWhenDone()
+{
+    if (deferredInitDone && sessionRestored && firstFramePainted)
+        StartupReport::print();
+}
+
+void MainWindow::paintEvent(QPaintEvent* event)
+{
+    QWidget::paintEvent(event);
+
+    if (!firstFramePainted) {
+        firstFramePainted = true;
+        StartupReport::mark("first frame");
+        printStartupReportWhenDone();
     }
-    qDebug() << "-------------------------------";
-    setupUi();
-    connectSignals();
+}
+
+MainWindow::Session MainWindow::loadSession(PlayStats* stats)
+{
+    Session session;
+    QSettings settings;
+    const QStringList files = settings.value("session/files").toStringList();
+    session.current = settings.value("session/current", -1).toInt();
+
+    session.files.reserve(files.size());
+    for (const QString& file : files)
+        session.files.push_back(file.toStdString());
+
+    // Play counts from earlier sessions, for the rows about to be added
+    std::string error;
+    if (!stats->open(PlayStats::defaultDirectory(), error))
+        qWarning("play statistics: %s", error.c_str());
+    return session;
+}
+
+void MainWindow::restoreSession()
+{
+    // Called on this thread once the future is ready, so result() does not block
+    Session session = pendingSession.result();
+
+    // Anything added in the meantime stays in front
+    const int first = model->rowCount();
+    addFiles(session.files);
+    // The restored list is the starting point, not an edit to undo
+    playlist->clearHistory();
+    refreshGroups();
+
+    // Highlight the last played track, but leave playback to the user
+    const int current = first + session.current;
+    if (session.current >= 0 && current < model->rowCount()) {
+        playlistView->selectRow(current);
+        playlistView->scrollTo(model->index(current, PlaylistModel::Title));
+    }
+
+    StartupReport::mark("session restore");
+    sessionRestored = true;
+    printStartupReportWhenDone();
+}
+
+void MainWindow::saveSession()
+{
+    QStringList files;
+    for (size_t i = 0; i < playlist->size(); ++i)
+        files << QString::fromStdString(playlist->at(i).filename);
+
+    QSettings settings;
+    settings.setValue("session/files", files);
+    settings.setValue("session/current", currentIndex);
+}
+
+void MainWindow::closeEvent(QCloseEvent* event)
+{
+    saveSession();
+    QWidget::closeEvent(event);
 }
 
 void MainWindow::setupUi()
 {
     setWindowTitle("Rensselaer Music Player");
 
-    playlistView = new QTableWidget(this);
-    playlistView->setColumnCount(5); // #, Title, Artist, Album, Duration
-    QStringList headers;
-    headers << "#" << "Title" << "Artist" << "Album" << "Duration";
-    playlistView->setHorizontalHeaderLabels(headers);
+    // #, Title, Artist, Album, Duration
+    model = new PlaylistModel(this);
+    playlistView = new QTableView(this);
+    playlistView->setModel(model);
 
-    // Make selection single row
+    // Select whole rows
     playlistView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    playlistView->setSelectionMode(QAbstractItemView::SingleSelection);
+    // Several rows can be selected to start a new playlist from them
+    playlistView->setSelectionMode(QAbstractItemView::ExtendedSelection);
     playlistView->setEditTriggers(QAbstractItemView::NoEditTriggers);
     QHeaderView* header = playlistView->horizontalHeader();
     playlistView->verticalHeader()->setVisible(false);
@@ -59,20 +179,29 @@ void MainWindow::setupUi()
     header->setSectionResizeMode(4, QHeaderView::Fixed);
     playlistView->setColumnWidth(4, 70);
 
+    // Header clicks sort the playlist itself (not just the view)
+    header->setSectionsClickable(true);
+    header->setSortIndicatorShown(false);
+
     openBtn  = new QPushButton("Open", this);
     removeBtn = new QPushButton("Remove", this);
 
+    playlistPicker = new QComboBox(this);
+    playlistPicker->addItem(QString::fromStdString(library.name(0)));
+    newPlaylistBtn = new QPushButton("New Playlist", this);
+    newPlaylistBtn->setToolTip("Copy of this playlist, or of the selected rows when several are selected");
+
     shuffleBtn   = new QPushButton(this);
     prevBtn      = new QPushButton(this);
     playPauseBtn = new QPushButton(this);
     nextBtn      = new QPushButton(this);
     repeatBtn    = new QPushButton(this);
 
-    shuffleBtn->setIcon(QIcon(":/icons/shuffle.svg"));
-    prevBtn->setIcon(QIcon(":/icons/previous.svg"));
-    playPauseBtn->setIcon(QIcon(":/icons/play.svg"));
-    nextBtn->setIcon(QIcon(":/icons/next.svg"));
-    repeatBtn->setIcon(QIcon(":/icons/repeat.svg"));
+    shuffleBtn->setIcon(IconCache::get("shuffle"));
+    prevBtn->setIcon(IconCache::get("previous"));
+    playPauseBtn->setIcon(IconCache::get("play"));
+    nextBtn->setIcon(IconCache::get("next"));
+    repeatBtn->setIcon(IconCache::get("repeat"));
 
     shuffleBtn->setToolTip("Enable Shuffle");
     prevBtn->setToolTip("Previous");
@@ -98,7 +227,17 @@ void MainWindow::setupUi()
     QVBoxLayout* controls = new QVBoxLayout;
     controls->addWidget(openBtn);
     controls->addWidget(removeBtn);
-    controls->addStretch();
+    controls->addWidget(playlistPicker);
+    controls->addWidget(newPlaylistBtn);
+
+    // Artist -> album browser fed by the playlist's group index
+    groupView = new QTreeWidget(this);
+    groupView->setColumnCount(3);
+    groupView->setHeaderLabels({"Artist / Album", "Tracks", "Length"});
+    groupView->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    groupView->header()->setStretchLastSection(false);
+    groupView->setToolTip("Double-click an album to play it");
+    controls->addWidget(groupView, 1);
 
     // Main layout (Spotify-style)
     QHBoxLayout* mainLayout = new QHBoxLayout;
@@ -164,273 +303,476 @@ void MainWindow::connectSignals()
 
     connect(playPauseBtn, &QPushButton::clicked, this, [this]() {
         if (isPlaying) {
-            player.pause();
-            playPauseBtn->setIcon(QIcon(":/icons/play.svg"));
+            playback.pause();
+            spectrum.clear();
+            playPauseBtn->setIcon(IconCache::get("play"));
             playPauseBtn->setToolTip("Play");
         } else {
-            player.play();
-            playPauseBtn->setIcon(QIcon(":/icons/pause.svg"));
+            playback.resume();
+            playPauseBtn->setIcon(IconCache::get("pause"));
             playPauseBtn->setToolTip("Pause");
         }
         isPlaying = !isPlaying;
     });
 
-    connect(nextBtn, &QPushButton::clicked, [this]() {
-        if (playlist.empty()) return;
-        playTrack(playlist.next());
-    });
-
-    connect(prevBtn, &QPushButton::clicked, [this]() {
-        if (playlist.empty()) return;
-        playTrack(playlist.prev());
-    });
+    connect(nextBtn, &QPushButton::clicked, [this]() { playback.next(); });
+    connect(prevBtn, &QPushButton::clicked, [this]() { playback.prev(); });
 
     connect(removeBtn, &QPushButton::clicked, this, &MainWindow::removeSelectedTrack);
 
+    connect(groupView, &QTreeWidget::itemDoubleClicked,
+            this, [this](QTreeWidgetItem* item, int /*column*/) {
+                if (!item->parent())
+                    return; // artist rows just expand / collapse
+                playAlbum(item->data(0, Qt::UserRole).toString().toStdString(),
+                          item->data(1, Qt::UserRole).toString().toStdString());
+            });
+
+    connect(playlistView->horizontalHeader(), &QHeaderView::sectionClicked,
+            this, [this](int column) {
+                playlistView->horizontalHeader()->setSortIndicatorShown(true);
+                sortByColumn(column);
+            });
+
     connect(shuffleBtn, &QPushButton::toggled, this, [this](bool on) {
         // qDebug() << "Shuffle:" << (on ? "ON" : "OFF");
         if (on) {
             // Shuffle playlist with a random seed
             std::random_device rd;
-            playlist.shuffle(rd());
+            playlist->shuffle(rd());
             shuffleBtn->setToolTip("Disable Shuffle");
         } else {
             // Disable shuffle
-            playlist.disableShuffle();
+            playlist->disableShuffle();
             shuffleBtn->setToolTip("Enable Shuffle");
         }
     });
 
     connect(repeatBtn, &QPushButton::clicked, this, [this]() {
-        auto mode = playlist.getRepeatMode();
+        auto mode = playlist->getRepeatMode();
 
         switch (mode) {
         case PlaylistImpl::RepeatMode::Off:
             mode = PlaylistImpl::RepeatMode::All;
             repeatBtn->setChecked(true);
-            repeatBtn->setIcon(QIcon(":/icons/repeat.svg"));   // normal repeat icon
+            repeatBtn->setIcon(IconCache::get("repeat"));   // normal repeat icon
             repeatBtn->setToolTip("Enable Repeat One");
             break;
         case PlaylistImpl::RepeatMode::All:
             mode = PlaylistImpl::RepeatMode::One;
             repeatBtn->setChecked(true);
-            repeatBtn->setIcon(QIcon(":/icons/repeat-1.svg")); // repeat one icon
+            repeatBtn->setIcon(IconCache::get("repeat-1")); // repeat one icon
             repeatBtn->setToolTip("Disable Repeat");
             break;
         case PlaylistImpl::RepeatMode::One:
             mode = PlaylistImpl::RepeatMode::Off;
             repeatBtn->setChecked(false);
-            repeatBtn->setIcon(QIcon(":/icons/repeat.svg"));   // normal icon but off
+            repeatBtn->setIcon(IconCache::get("repeat"));   // normal icon but off
             repeatBtn->setToolTip("Enable Repeat");
             break;
         }
 
-        playlist.setRepeatMode(mode);
+        playlist->setRepeatMode(mode);
     });
 
-    connect(playlistView, &QTableWidget::cellDoubleClicked,
-            [this](int row, int /*column*/) {
-                if (row >= 0 && row < playlistView->rowCount())
-                    playTrack(playlist.at(row));
+    connect(playlistView, &QTableView::doubleClicked,
+            [this](const QModelIndex& index) {
+                if (index.isValid())
+                    playback.play(size_t(index.row()));
             });
 
-    connect(&player, &QMediaPlayer::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
-        if (status == QMediaPlayer::EndOfMedia) {
-            // Track finished, play next track
-            if (!playlist.empty()) {
-                Track nextTrack = playlist.next();
-                playTrack(nextTrack);
-            }
+    // Tags are read on the loader's thread and written in on this one,
+    // rows on screen first
+    loader.setWakeup([this]() {
+        QMetaObject::invokeMethod(this, [this]() { applyTags(); }, Qt::QueuedConnection);
+    });
+    connect(playlistView->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &MainWindow::requestVisibleTags);
+    connect(playlistView->verticalScrollBar(), &QScrollBar::rangeChanged,
+            this, &MainWindow::requestVisibleTags);
+
+    // Track changes, including the next track after one ends, come from
+    // the playback controller
+    playback.setPlaylist(playlist);
+    playback.setPlayStats(&playStats);
+    PlaybackController::Hooks hooks;
+    hooks.trackStarted = [this](size_t index, const Track&) {
+        showPlaying(int(index));
+        loader.follow(*playlist);
+    };
+    hooks.durationChanged = [this](int64_t duration) {
+        progressSlider->setRange(0, duration);
+        progressSlider->setEnabled(duration > 0);
+
+        // A position change is visible once it moves the slider by a pixel
+        qint64 perPixel = duration / qMax(1, progressSlider->width());
+        uiScheduler.setPositionResolution(qBound<qint64>(1, perPixel, 1000));
+        uiScheduler.setDuration(duration);
+        scheduleUiUpdate();
+    };
+    hooks.positionChanged = [this](int64_t position) {
+        uiScheduler.setPosition(position);
+        scheduleUiUpdate();
+    };
+    hooks.stateChanged = [this](PlaybackBackend::State state) {
+        using State = UpdateScheduler::State;
+        switch (state) {
+        case PlaybackBackend::State::Playing:   uiScheduler.setState(State::Playing);   break;
+        case PlaybackBackend::State::Paused:    uiScheduler.setState(State::Paused);    break;
+        case PlaybackBackend::State::Buffering: uiScheduler.setState(State::Buffering); break;
+        case PlaybackBackend::State::Error:     uiScheduler.setState(State::Error);     break;
+        case PlaybackBackend::State::Stopped:   uiScheduler.setState(State::Stopped);   break;
         }
+        scheduleUiUpdate();
+    };
+    playback.setHooks(std::move(hooks));
+
+    connect(&uiTimer, &QTimer::timeout, this, &MainWindow::applyUiUpdate);
+
+    connect(newPlaylistBtn, &QPushButton::clicked, this, &MainWindow::newPlaylist);
+    connect(playlistPicker, &QComboBox::currentIndexChanged, this, &MainWindow::switchPlaylist);
+
+    auto* undoShortcut = new QShortcut(QKeySequence::Undo, this);
+    connect(undoShortcut, &QShortcut::activated, this, [this]() { undoEdit(false); });
+    auto* redoShortcut = new QShortcut(QKeySequence::Redo, this);
+    connect(redoShortcut, &QShortcut::activated, this, [this]() { undoEdit(true); });
+
+    // Debug panel: heap use by subsystem
+    auto* memoryShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_M), this);
+    connect(memoryShortcut, &QShortcut::activated, this, [this]() {
+        if (!memoryPanel)
+            memoryPanel = new MemoryPanel([this]() { return library.tracks().size(); }, this);
+        memoryPanel->show();
+        memoryPanel->raise();
     });
 
-    connect(&player, &QMediaPlayer::durationChanged,
-            this, [this](qint64 duration) {
-                progressSlider->setRange(0, duration);
-                progressSlider->setEnabled(duration > 0);
-            });
-
-    connect(&player, &QMediaPlayer::positionChanged,
-            this, [this](qint64 position) {
-                if (!progressSlider->isSliderDown())
-                    progressSlider->setValue(position);
-
-                qint64 dur = player.duration();
-                auto formatTime = [](qint64 ms) {
-                    int sec = ms / 1000;
-                    return QString("%1:%2")
-                        .arg(sec / 60)
-                        .arg(sec % 60, 2, 10, QChar('0'));
-                };
-
-                timeLabel->setText(
-                    formatTime(position) + " / " + formatTime(dur)
-                    );
-            });
-
     connect(progressSlider, &QSlider::sliderMoved,
             this, [this](int value) {
-                player.setPosition(value);
+                backend.seek(value);
             });
 }
 
+void MainWindow::scheduleUiUpdate()
+{
+    if (!uiScheduler.pending() || uiTimer.isActive())
+        return;
+
+    auto wait = uiScheduler.timeUntilDue(UpdateScheduler::Clock::now());
+    uiTimer.start(int(std::chrono::ceil<std::chrono::milliseconds>(wait).count()));
+}
+
+void MainWindow::applyUiUpdate()
+{
+    UpdateScheduler::Snapshot snap;
+    if (!uiScheduler.poll(UpdateScheduler::Clock::now(), snap))
+        return;
+
+    if (!progressSlider->isSliderDown())
+        progressSlider->setValue(snap.positionMs);
+
+    // Only reformat the label when a displayed second changes
+    qint64 posSec = snap.positionMs / 1000;
+    qint64 durSec = snap.durationMs / 1000;
+    if (posSec == shownPositionSec && durSec == shownDurationSec)
+        return;
+    shownPositionSec = posSec;
+    shownDurationSec = durSec;
+
+    auto formatTime = [](qint64 sec) {
+        return QString("%1:%2")
+            .arg(sec / 60)
+            .arg(sec % 60, 2, 10, QChar('0'));
+    };
+
+    timeLabel->setText(formatTime(posSec) + " / " + formatTime(durSec));
+}
+
 void MainWindow::addTrackFromFile()
 {
     QStringList files = QFileDialog::getOpenFileNames(
         this,
         "Open Audio Files",
         "",
-        "Audio Files (*.mp3 *.wav *.ogg)"
+        "Audio Files (*.mp3 *.flac *.wav *.ogg)"
         );
 
     if (files.isEmpty())
         return;
 
-    for (const QString& file : files) {
-        Track t;
-        t.filename = file.toStdString();
-
-        // Get metadata
-        Mp3Metadata data = Mp3Reader::read(t.filename);
-        t.title  = data.title;
-        t.artist = data.artist;
-        t.album  = data.album;
-
-        // Use temporary QMediaPlayer to get duration
-        QMediaPlayer probePlayer;
-        QAudioOutput audioOutput;
-        probePlayer.setAudioOutput(&audioOutput);
-        probePlayer.setSource(QUrl::fromLocalFile(file));
-
-        QEventLoop loop;
-        QObject::connect(&probePlayer, &QMediaPlayer::durationChanged, &loop, &QEventLoop::quit);
-        loop.exec();
-
-        t.lengthSeconds = probePlayer.duration() / 1000;
-
-        // Add to playlist
-        playlist.add(t);
-
-        // Add row to table
-        int row = playlistView->rowCount();
-        playlistView->insertRow(row);
-        auto* indexItem = new QTableWidgetItem(QString::number(row + 1));
-        indexItem->setTextAlignment(Qt::AlignCenter);
-        playlistView->setItem(row, 0, indexItem);
-        playlistView->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(t.title)));
-        playlistView->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(t.artist)));
-        playlistView->setItem(row, 3, new QTableWidgetItem(QString::fromStdString(t.album)));
-
-        int minutes = t.lengthSeconds / 60;
-        int seconds = t.lengthSeconds % 60;
-        QString lenStr = QString("%1:%2").arg(minutes).arg(seconds, 2, 10, QChar('0'));
-        auto* durationItem = new QTableWidgetItem(lenStr);
-        durationItem->setTextAlignment(Qt::AlignCenter);
-        playlistView->setItem(row, 4, durationItem);
-    }
+    std::vector<std::string> paths;
+    paths.reserve(files.size());
+    for (const QString& file : files)
+        paths.push_back(file.toStdString());
+    addFiles(paths);
+    // One undo step per dialog
+    playlist->checkpoint();
+    refreshGroups();
 
     // Start playing the first of the new selection
-    if (!files.isEmpty()) {
-        playTrack(playlist.at(currentIndex >= 0 ? currentIndex : 0));
-        playPauseBtn->setIcon(QIcon(":/icons/pause.svg"));
-    }
+    playback.play(currentIndex >= 0 ? size_t(currentIndex) : 0);
+    playPauseBtn->setIcon(IconCache::get("pause"));
 }
 
-void MainWindow::playTrack(const Track& t)
+void MainWindow::addFiles(const std::vector<std::string>& files)
 {
-    if (t.filename.empty())
+    MemoryScope scope(MemoryTag::Ui);
+    const size_t first = playlist->size();
+    for (const std::string& file : files)
+        playlist->add(MetadataLoader::placeholder(file));
+    model->appended(*playlist);
+    playStats.restore(*playlist, first, playlist->size());
+
+    loader.enqueue(*playlist, first, playlist->size());
+    loader.follow(*playlist);
+    requestVisibleTags();
+}
+
+void MainWindow::requestVisibleTags()
+{
+    const int first = playlistView->rowAt(0);
+    if (first < 0)
         return;
+    int last = playlistView->rowAt(playlistView->viewport()->height() - 1);
+    if (last < 0)
+        last = model->rowCount() - 1;
+    loader.setVisible(*playlist, size_t(first), size_t(last) + 1);
+}
 
-    player.setSource(QUrl::fromLocalFile(QString::fromStdString(t.filename)));
-    player.play();
-
-    // Remove previous bold & indicator
-    if (currentIndex >= 0 && currentIndex < playlistView->rowCount()) {
-        for (int col = 0; col < playlistView->columnCount(); ++col)
-            playlistView->item(currentIndex, col)->setFont(QFont());
-
-        // Remove previous TrackIndicator if exists
-        QWidget* w = playlistView->cellWidget(currentIndex, 0);
-        if (w) {
-            playlistView->removeCellWidget(currentIndex, 0);
-            delete w;
-            // Restore track number
-            playlistView->setItem(currentIndex, 0, new QTableWidgetItem(QString::number(currentIndex + 1)));
+void MainWindow::applyTags()
+{
+    std::vector<TrackId> ids = loader.apply(library);
+    if (ids.empty())
+        return;
+
+    // One change for the whole span; the view only repaints what is on screen
+    int first = model->rowCount();
+    int last = -1;
+    for (TrackId id : ids) {
+        int row = playlist->indexOf(id);
+        if (row >= 0) {
+            first = qMin(first, row);
+            last = qMax(last, row);
         }
     }
+    model->updated(*playlist, first, last);
+
+    // Groups are rebuilt from scratch, so only once the import is done
+    if (loader.pending() == 0)
+        refreshGroups();
+}
 
-    // Set new currentIndex
-    for (int i = 0; i < playlistView->rowCount(); ++i) {
-        if (playlist.at(i).filename == t.filename) {
-            currentIndex = i;
+void MainWindow::sortByColumn(int column)
+{
+    // Clicking the same header again flips the direction
+    sortDescending = (column == sortColumn) ? !sortDescending : false;
+    sortColumn = column;
+
+    std::vector<SortKey> keys;
+    switch (column) {
+    case 1: keys = { { SortField::Title } }; break;
+    case 2: keys = defaultSortKeys(); break;
+    case 3: keys = { { SortField::Album }, { SortField::TrackNumber }, { SortField::Title } }; break;
+    case 4: keys = { { SortField::Length }, { SortField::Title } }; break;
+    default: keys = defaultSortKeys(); break;
+    }
+    // Direction applies to the clicked column; tie-breakers stay ascending
+    keys.front().descending = sortDescending;
+
+    playlistView->horizontalHeader()->setSortIndicator(
+        column, sortDescending ? Qt::DescendingOrder : Qt::AscendingOrder);
+
+    std::vector<size_t> order = playlist->sortBy(keys);
+
+    int playing = -1;
+    for (size_t i = 0; i < order.size() && currentIndex >= 0; ++i) {
+        if (order[i] == size_t(currentIndex)) {
+            playing = int(i);
             break;
         }
     }
+    reloadRows(playing);
+}
 
-    // Bold all columns of current row
-    if (currentIndex >= 0) {
-        QFont boldFont;
-        boldFont.setBold(true);
-        for (int col = 1; col < playlistView->columnCount(); ++col)
-            playlistView->item(currentIndex, col)->setFont(boldFont);
-
-        // Replace track number with animated indicator
-        TrackIndicator* indicator = new TrackIndicator;
-        playlistView->setCellWidget(currentIndex, 0, indicator);
-        indicator->start();
+void MainWindow::undoEdit(bool redo)
+{
+    TrackId playingId = currentIndex >= 0 ? playlist->idAt(currentIndex) : TrackId(-1);
+    if (!(redo ? playlist->redo() : playlist->undo()))
+        return;
+
+    // The playing track may have moved, or be gone after undoing its add
+    reloadRows(currentIndex >= 0 ? playlist->indexOf(playingId) : -1);
+    refreshGroups();
+}
+
+void MainWindow::newPlaylist()
+{
+    std::vector<size_t> rows;
+    for (const QModelIndex& index : playlistView->selectionModel()->selectedRows())
+        rows.push_back(size_t(index.row()));
+
+    // Only the ids are copied; the tracks stay where they are in the store
+    const std::string name = library.unusedName("Playlist");
+    size_t created = rows.size() > 1 ? library.createFrom(activePlaylist, rows, name)
+                                     : library.fork(activePlaylist, name);
+
+    playlistPicker->addItem(QString::fromStdString(name));
+    playlistPicker->setCurrentIndex(int(created)); // switches through switchPlaylist
+}
+
+void MainWindow::switchPlaylist(int index)
+{
+    if (index < 0 || size_t(index) >= library.count() || size_t(index) == activePlaylist)
+        return;
 
+    // Keep highlighting the playing track if the other playlist has it too
+    TrackId playingId = currentIndex >= 0 ? playlist->idAt(currentIndex) : TrackId(-1);
+    activePlaylist = size_t(index);
+    playlist = &library.playlist(activePlaylist);
+    playback.setPlaylist(playlist);
+
+    int playing = currentIndex >= 0 ? playlist->indexOf(playingId) : -1;
+    if (playing >= 0)
+        playlist->setCurrent(size_t(playing));
+    reloadRows(playing);
+    refreshGroups();
+    shuffleBtn->setChecked(playlist->shuffled());
+}
+
+void MainWindow::reloadRows(int playingRow)
+{
+    MemoryScope scope(MemoryTag::Ui);
+    // A reset drops the indicator widget along with the old rows
+    model->reset(*playlist);
+    markPlaying(playingRow);
+    if (currentIndex >= 0)
         playlistView->selectRow(currentIndex);
-        playlistView->scrollToItem(playlistView->item(currentIndex, 1));
+    requestVisibleTags();
+    loader.follow(*playlist);
+}
+
+void MainWindow::showPlaying(int row)
+{
+    spectrum.clear();
+    markPlaying(row);
+    if (currentIndex >= 0) {
+        playlistView->selectRow(currentIndex);
+        playlistView->scrollTo(model->index(currentIndex, PlaylistModel::Title));
     }
     progressSlider->setValue(0);
     timeLabel->setText("0:00 / 0:00");
+    shownPositionSec = 0;
+    shownDurationSec = 0;
+    uiScheduler.invalidate();
+}
+
+void MainWindow::markPlaying(int row)
+{
+    // Replacing an index widget deletes the old one
+    if (currentIndex >= 0 && currentIndex < model->rowCount())
+        playlistView->setIndexWidget(model->index(currentIndex, PlaylistModel::Number), nullptr);
+
+    currentIndex = row >= 0 && row < model->rowCount() ? row : -1;
+    model->setPlayingRow(currentIndex);
+
+    // Replace track number with animated indicator
+    if (currentIndex >= 0) {
+        TrackIndicator* indicator = new TrackIndicator(&spectrum);
+        playlistView->setIndexWidget(model->index(currentIndex, PlaylistModel::Number), indicator);
+        indicator->start();
+    }
+}
+
+void MainWindow::refreshGroups()
+{
+    MemoryScope scope(MemoryTag::Ui);
+    auto formatLength = [](int64_t sec) {
+        if (sec >= 3600)
+            return QString("%1:%2:%3").arg(sec / 3600)
+                .arg((sec / 60) % 60, 2, 10, QChar('0'))
+                .arg(sec % 60, 2, 10, QChar('0'));
+        return QString("%1:%2").arg(sec / 60).arg(sec % 60, 2, 10, QChar('0'));
+    };
+
+    // Only walks the groups, never the tracks
+    groupView->setUpdatesEnabled(false);
+    groupView->clear();
+    for (const auto& [artistKey, artist] : playlist->groups().all()) {
+        auto* artistItem = new QTreeWidgetItem(groupView);
+        artistItem->setText(0, QString::fromStdString(artist.name));
+        artistItem->setText(1, QString::number(artist.trackCount));
+        artistItem->setText(2, formatLength(artist.totalSeconds));
+
+        for (const auto& [albumKey, album] : artist.albums) {
+            auto* albumItem = new QTreeWidgetItem(artistItem);
+            albumItem->setText(0, QString::fromStdString(album.name));
+            albumItem->setText(1, QString::number(album.trackCount));
+            albumItem->setText(2, formatLength(album.totalSeconds));
+            albumItem->setData(0, Qt::UserRole, QString::fromStdString(artist.name));
+            albumItem->setData(1, Qt::UserRole, QString::fromStdString(album.name));
+        }
+    }
+    groupView->sortItems(0, Qt::AscendingOrder);
+    groupView->setUpdatesEnabled(true);
+}
+
+void MainWindow::playAlbum(const std::string& artist, const std::string& album)
+{
+    std::vector<size_t> rows = playlist->albumTracks(artist, album);
+    if (rows.empty())
+        return;
+
+    playback.play(rows.front());
+    playPauseBtn->setIcon(IconCache::get("pause"));
+    isPlaying = true;
 }
 
 void MainWindow::removeSelectedTrack()
 {
-    int row = playlistView->currentRow();
+    int row = playlistView->currentIndex().row();
     if (row < 0) return;
 
     bool removingCurrent = (row == currentIndex);
 
     if (removingCurrent) {
-        player.stop();
+        playback.stop();
+        spectrum.clear();
     }
 
-    playlist.removeAt(row);
-    playlistView->removeRow(row);
+    // The row's indicator, if any, goes with it
+    playlist->removeAt(row);
+    model->removed(*playlist, row);
+    refreshGroups();
 
-    if (playlistView->rowCount() == 0) {
+    if (removingCurrent)
         currentIndex = -1;
-        updateTrackNumbers();
-        return;
-    }
-
-    if (row < currentIndex) {
+    else if (row < currentIndex)
         currentIndex--;
-    }
 
-    updateTrackNumbers();
-
-    if (removingCurrent) {
-        int next = qMin(row, playlistView->rowCount() - 1);
-        playTrack(playlist.at(next));
+    if (removingCurrent && model->rowCount() > 0) {
+        int next = qMin(row, model->rowCount() - 1);
+        playback.play(size_t(next));
     }
 }
 
-void MainWindow::updateTrackNumbers()
+void MainWindow::feedSpectrum(const QAudioBuffer& buffer)
 {
-    for (int row = 0; row < playlistView->rowCount(); ++row) {
-
-        // Remove any existing widget (indicator or stale widget)
-        QWidget* w = playlistView->cellWidget(row, 0);
-        if (w) {
-            playlistView->removeCellWidget(row, 0);
-            delete w;
-        }
+    MemoryScope scope(MemoryTag::Audio);
+    const QAudioFormat format = buffer.format();
+    const int channels = format.channelCount();
+    const int bytesPerSample = format.bytesPerSample();
+    const qsizetype frames = buffer.frameCount();
+    if (channels <= 0 || bytesPerSample <= 0 || frames <= 0)
+        return;
 
-        auto* item = new QTableWidgetItem(QString::number(row + 1));
-        item->setTextAlignment(Qt::AlignCenter);
-        playlistView->setItem(row, 0, item);
+    // Downmix to mono floats; the analyzer only keeps the newest frame
+    spectrumScratch.resize(frames);
+    const char* data = buffer.constData<char>();
+    for (qsizetype i = 0; i < frames; ++i) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            sum += format.normalizedSampleValue(data + (i * channels + c) * bytesPerSample);
+        spectrumScratch[i] = sum / channels;
     }
+
+    spectrum.pushSamples(spectrumScratch.data(), spectrumScratch.size(), format.sampleRate());
 }
@@ -4,12 +4,29 @@
 #include <QMediaPlayer>
 #include <QAudioOutput>
 #include <QListWidget>
-#include <QTableWidget>
+#include <QTableView>
 #include <QPushButton>
 #include <QSlider>
 #include <QLabel>
+#include <QTreeWidget>
+#include <QComboBox>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <vector>
 
 #include "PlaylistImpl.h"
+#include "Library.h"
+#include "MetadataLoader.h"
+#include "PlaybackController.h"
+#include "PlayStats.h"
+#include "Prefetcher.h"
+#include "QtPlaybackBackend.h"
+#include "SpectrumAnalyzer.h"
+#include "UpdateScheduler.h"
+
+class QAudioBuffer;
+class MemoryPanel;
+class PlaylistModel;
 
 class MainWindow : public QWidget
 {
@@ -17,23 +34,54 @@ class MainWindow : public QWidget
 
 public:
     explicit MainWindow(QWidget* parent = nullptr);
+    ~MainWindow() override;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void closeEvent(QCloseEvent* event) override;
 
 private:
+    struct Session {
+        std::vector<std::string> files;
+        int current = -1;
+    };
+
     // Core (student logic)
-    PlaylistImpl playlist;
+    Library library;
+    size_t activePlaylist = 0;
+    PlaylistImpl* playlist = &library.playlist(0); // the one shown and played
+    MetadataLoader loader; // tags of rows added by file name
     int currentIndex = -1;
+    int sortColumn = -1;
+    bool sortDescending = false;
     // Playback state
     bool isPlaying = false;
 
     // Audio
     QMediaPlayer player;
     QAudioOutput audio;
+    SpectrumAnalyzer spectrum{5};
+    std::vector<float> spectrumScratch;
+    Prefetcher prefetcher;
+    PlayStats playStats;
+    QtPlaybackBackend backend{player};
+    PlaybackController playback{backend, &prefetcher};
+
+    // Startup
+    QFutureWatcher<Session> pendingSession;
+    bool deferredInitDone = false;
+    bool sessionRestored = false;
+    bool firstFramePainted = false;
 
     // UI elements
-    QTableWidget* playlistView;
+    PlaylistModel* model;
+    QTableView* playlistView;
+    QTreeWidget* groupView;
 
     QPushButton* openBtn;
     QPushButton* removeBtn;
+    QComboBox* playlistPicker;
+    QPushButton* newPlaylistBtn;
 
     QPushButton* shuffleBtn;
     QPushButton* prevBtn;
@@ -44,11 +92,41 @@ private:
     QSlider* progressSlider;
     QLabel*  timeLabel;
 
+    MemoryPanel* memoryPanel = nullptr; // created on first Ctrl+Shift+M
+
+    // Position / status repaint pacing
+    UpdateScheduler uiScheduler;
+    QTimer uiTimer;
+    qint64 shownPositionSec = 0;
+    qint64 shownDurationSec = 0;
+
     // Helpers
     void setupUi();
+    void deferredInit();
+    static Session loadSession(PlayStats* stats);
+    void restoreSession();
+    void printStartupReportWhenDone();
+    void saveSession();
+    // Rows go in at once with file names only; the tags follow
+    void addFiles(const std::vector<std::string>& files);
+    void requestVisibleTags();
+    void applyTags();
+    void sortByColumn(int column);
+    // Rewrites every row from the playlist and marks playingRow as playing
+    void reloadRows(int playingRow);
+    void undoEdit(bool redo);
+    void newPlaylist();
+    void switchPlaylist(int index);
     void connectSignals();
     void addTrackFromFile();
-    void playTrack(const Track& t);
+    // Moves the playing highlight to row, whose track has just started
+    void showPlaying(int row);
+    // Moves the indicator and bold text to row (-1: none)
+    void markPlaying(int row);
     void removeSelectedTrack();
-    void updateTrackNumbers();
+    void refreshGroups();
+    void playAlbum(const std::string& artist, const std::string& album);
+    void feedSpectrum(const QAudioBuffer& buffer);
+    void scheduleUiUpdate();
+    void applyUiUpdate();
 };
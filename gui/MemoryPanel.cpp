@@ -0,0 +1,44 @@
+#include "MemoryPanel.h"
+#include "MemoryStats.h"
+
+#include <QFontDatabase>
+#include <QPlainTextEdit>
+#include <QVBoxLayout>
+
+MemoryPanel::MemoryPanel(std::function<size_t()> trackCount, QWidget* parent)
+    : QWidget(parent, Qt::Tool),
+    trackCount(std::move(trackCount))
+{
+    setWindowTitle("Memory");
+
+    text = new QPlainTextEdit(this);
+    text->setReadOnly(true);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(text);
+    resize(560, 320);
+
+    timer.setInterval(1000);
+    connect(&timer, &QTimer::timeout, this, &MemoryPanel::refresh);
+}
+
+void MemoryPanel::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    timer.start();
+}
+
+void MemoryPanel::hideEvent(QHideEvent* event)
+{
+    timer.stop();
+    QWidget::hideEvent(event);
+}
+
+void MemoryPanel::refresh()
+{
+    text->setPlainText(QString::fromStdString(MemoryStats::report(trackCount())));
+}
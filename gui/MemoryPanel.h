@@ -0,0 +1,26 @@
+#pragma once
+#include <QTimer>
+#include <QWidget>
+
+#include <functional>
+
+class QPlainTextEdit;
+
+// Debug window with MemoryStats::report(), refreshed once a second while
+// it is shown
+class MemoryPanel : public QWidget {
+    Q_OBJECT
+public:
+    MemoryPanel(std::function<size_t()> trackCount, QWidget* parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+private:
+    void refresh();
+
+    std::function<size_t()> trackCount;
+    QPlainTextEdit* text;
+    QTimer timer;
+};
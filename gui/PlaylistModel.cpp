@@ -0,0 +1,119 @@
+#include "PlaylistModel.h"
+
+#include <QFont>
+
+PlaylistModel::PlaylistModel(QObject* parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+void PlaylistModel::reset(const PlaylistImpl& playlist)
+{
+    beginResetModel();
+    rows = playlist.snapshot();
+    if (playing >= int(rows.size()))
+        playing = -1;
+    endResetModel();
+}
+
+void PlaylistModel::appended(const PlaylistImpl& playlist)
+{
+    const int before = int(rows.size());
+    const int after = int(playlist.size());
+    if (after <= before) {
+        reset(playlist);
+        return;
+    }
+    beginInsertRows(QModelIndex(), before, after - 1);
+    rows = playlist.snapshot();
+    endInsertRows();
+}
+
+void PlaylistModel::removed(const PlaylistImpl& playlist, int row)
+{
+    beginRemoveRows(QModelIndex(), row, row);
+    rows = playlist.snapshot();
+    if (playing == row)
+        playing = -1;
+    else if (playing > row)
+        playing--;
+    endRemoveRows();
+
+    // Numbers below the removed row moved up by one
+    if (row < int(rows.size()))
+        emit dataChanged(index(row, Number), index(int(rows.size()) - 1, Number), { Qt::DisplayRole });
+}
+
+void PlaylistModel::updated(const PlaylistImpl& playlist, int firstRow, int lastRow)
+{
+    rows = playlist.snapshot();
+    if (firstRow <= lastRow)
+        emit dataChanged(index(firstRow, 0), index(lastRow, ColumnCount - 1));
+}
+
+void PlaylistModel::setPlayingRow(int row)
+{
+    const int old = playing;
+    playing = row;
+    if (old >= 0)
+        emit dataChanged(index(old, 0), index(old, ColumnCount - 1), { Qt::FontRole });
+    if (row >= 0)
+        emit dataChanged(index(row, 0), index(row, ColumnCount - 1), { Qt::FontRole });
+}
+
+int PlaylistModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(rows.size());
+}
+
+int PlaylistModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant PlaylistModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= int(rows.size()))
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        const Track& t = *rows[size_t(index.row())].track;
+        switch (index.column()) {
+        case Number: return index.row() + 1;
+        case Title:  return QString::fromStdString(t.title);
+        case Artist: return QString::fromStdString(t.artist);
+        case Album:  return QString::fromStdString(t.album);
+        case Length:
+            return QString("%1:%2").arg(t.lengthSeconds / 60).arg(t.lengthSeconds % 60, 2, 10, QChar('0'));
+        }
+        return QVariant();
+    }
+    case Qt::TextAlignmentRole:
+        if (index.column() == Number || index.column() == Length)
+            return int(Qt::AlignCenter);
+        return QVariant();
+    case Qt::FontRole:
+        if (index.row() == playing && index.column() != Number) {
+            QFont bold;
+            bold.setBold(true);
+            return bold;
+        }
+        return QVariant();
+    }
+    return QVariant();
+}
+
+QVariant PlaylistModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch (section) {
+    case Number: return QString("#");
+    case Title:  return QString("Title");
+    case Artist: return QString("Artist");
+    case Album:  return QString("Album");
+    case Length: return QString("Duration");
+    }
+    return QVariant();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <QAbstractTableModel>
+
+#include "PlaylistImpl.h"
+
+// Table model over the shown playlist. Cells are read from a snapshot of
+// the playlist on demand, so the view only ever formats the rows on
+// screen and a playlist of any length goes in at once.
+//
+// The model shows the snapshot it was last told about; call the matching
+// notifier after every change to the playlist.
+class PlaylistModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum Column { Number, Title, Artist, Album, Length, ColumnCount };
+
+    explicit PlaylistModel(QObject* parent = nullptr);
+
+    // Shows playlist from scratch (switch, sort, undo)
+    void reset(const PlaylistImpl& playlist);
+    // Rows appended to the end
+    void appended(const PlaylistImpl& playlist);
+    // One row removed
+    void removed(const PlaylistImpl& playlist, int row);
+    // Tracks changed in place, e.g. once their tags were read
+    void updated(const PlaylistImpl& playlist, int firstRow, int lastRow);
+
+    // Drawn in bold; -1 for none
+    void setPlayingRow(int row);
+    int playingRow() const { return playing; }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    PlaylistImpl::Snapshot rows;
+    int playing = -1;
+};
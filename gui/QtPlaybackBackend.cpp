@@ -0,0 +1,74 @@
+#include "QtPlaybackBackend.h"
+
+#include <QUrl>
+
+QtPlaybackBackend::QtPlaybackBackend(QMediaPlayer& mediaPlayer)
+    : player(mediaPlayer)
+{
+    // Loading and buffering show in the media status, not the playback state
+    connect(&player, &QMediaPlayer::playbackStateChanged, this, [this]() { refreshState(); });
+    connect(&player, &QMediaPlayer::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
+        refreshState();
+        if (status == QMediaPlayer::EndOfMedia)
+            emitEndOfTrack();
+    });
+    connect(&player, &QMediaPlayer::errorOccurred, this, [this]() { refreshState(); });
+    connect(&player, &QMediaPlayer::durationChanged, this, [this](qint64 ms) { emitDuration(ms); });
+    connect(&player, &QMediaPlayer::positionChanged, this, [this](qint64 ms) { emitPosition(ms); });
+}
+
+void QtPlaybackBackend::load(const std::string& filename)
+{
+    player.setSource(QUrl::fromLocalFile(QString::fromStdString(filename)));
+    player.play();
+}
+
+void QtPlaybackBackend::play()
+{
+    player.play();
+}
+
+void QtPlaybackBackend::pause()
+{
+    player.pause();
+}
+
+void QtPlaybackBackend::stop()
+{
+    player.stop();
+}
+
+void QtPlaybackBackend::seek(int64_t ms)
+{
+    player.setPosition(ms);
+}
+
+PlaybackBackend::State QtPlaybackBackend::state() const
+{
+    if (player.error() != QMediaPlayer::NoError)
+        return State::Error;
+    switch (player.playbackState()) {
+    case QMediaPlayer::PlayingState:
+        switch (player.mediaStatus()) {
+        case QMediaPlayer::LoadingMedia:
+        case QMediaPlayer::BufferingMedia:
+        case QMediaPlayer::StalledMedia:
+            return State::Buffering;
+        default:
+            return State::Playing;
+        }
+    case QMediaPlayer::PausedState:
+        return State::Paused;
+    default:
+        return State::Stopped;
+    }
+}
+
+void QtPlaybackBackend::refreshState()
+{
+    State now = state();
+    if (now == shownState)
+        return;
+    shownState = now;
+    emitState(now);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PlaybackBackend.h"
+
+#include <QMediaPlayer>
+#include <QObject>
+
+// PlaybackBackend on a QMediaPlayer. The window keeps owning the player,
+// since it also sets up the audio output and the spectrum tap on it.
+// Events come from the player's signals, on the GUI thread.
+class QtPlaybackBackend : public QObject, public PlaybackBackend {
+public:
+    explicit QtPlaybackBackend(QMediaPlayer& player);
+
+    void load(const std::string& filename) override;
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void seek(int64_t ms) override;
+
+    State state() const override;
+    int64_t position() const override { return player.position(); }
+    int64_t duration() const override { return player.duration(); }
+
+private:
+    // Emits the state when it differs from the last one emitted
+    void refreshState();
+
+    QMediaPlayer& player;
+    State shownState = State::Stopped;
+};
@@ -0,0 +1,65 @@
+#include "StartupReport.h"
+#include <QElapsedTimer>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct Phase {
+    const char* name;
+    qint64 endNs;
+};
+
+struct State {
+    bool enabled = false;
+    bool printed = false;
+    QElapsedTimer clock;
+    std::vector<Phase> phases;
+};
+
+State& state()
+{
+    static State s;
+    return s;
+}
+
+}
+
+void StartupReport::enable()
+{
+    state().enabled = true;
+    state().clock.start();
+}
+
+bool StartupReport::enabled()
+{
+    return state().enabled;
+}
+
+void StartupReport::mark(const char* phase)
+{
+    State& s = state();
+    if (s.enabled && !s.printed)
+        s.phases.push_back({phase, s.clock.nsecsElapsed()});
+}
+
+void StartupReport::print()
+{
+    State& s = state();
+    if (!s.enabled || s.printed)
+        return;
+    s.printed = true;
+
+    std::fprintf(stderr, "startup report:\n");
+    qint64 previous = 0;
+    for (const Phase& p : s.phases) {
+        std::fprintf(stderr, "  %-20s %8.2f ms   (at %8.2f ms)\n",
+                     p.name, (p.endNs - previous) / 1e6, p.endNs / 1e6);
+        previous = p.endNs;
+    }
+    for (const Phase& p : s.phases) {
+        if (std::string_view(p.name) == "first frame")
+            std::fprintf(stderr, "time to first frame: %.2f ms\n", p.endNs / 1e6);
+    }
+}
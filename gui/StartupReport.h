@@ -0,0 +1,14 @@
+#pragma once
+
+// Per-phase wall-clock timings for `player --startup-report`.
+// All calls are no-ops unless enable() was called.
+class StartupReport {
+public:
+    static void enable();
+    static bool enabled();
+
+    // Records the time spent since the previous mark under this phase name
+    static void mark(const char* phase);
+    // Prints the collected phases to stderr (once)
+    static void print();
+};
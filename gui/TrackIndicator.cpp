@@ -1,30 +1,92 @@
 #include "TrackIndicator.h"
+#include "AnimationClock.h"
 #include <QPainter>
-#include <QRandomGenerator>
 
-TrackIndicator::TrackIndicator(QWidget* parent)
-    : QWidget(parent)
+TrackIndicator::TrackIndicator(const SpectrumAnalyzer* spectrum, QWidget* parent)
+    : QWidget(parent),
+    spectrum(spectrum)
 {
     setFixedSize(20, 20);
-    timer = new QTimer(this);
-    // Use a lambda to explicitly call update():
-    connect(timer, &QTimer::timeout, this, [this]() {
-        update();
-    });
+    connect(AnimationClock::instance(), &AnimationClock::tick, this, &TrackIndicator::advance);
+}
+
+TrackIndicator::~TrackIndicator()
+{
+    if (subscribed)
+        AnimationClock::instance()->unsubscribe();
+}
+
+void TrackIndicator::start() { running = true;  updateSubscription(); }
+void TrackIndicator::stop()  { running = false; updateSubscription(); }
+
+void TrackIndicator::showEvent(QShowEvent*)
+{
+    // Minimizing leaves isVisible() true, so watch the top-level window's
+    // state too; the indicator may have moved to another window meanwhile
+    if (window() != watchedWindow) {
+        if (watchedWindow)
+            watchedWindow->removeEventFilter(this);
+        watchedWindow = window();
+        watchedWindow->installEventFilter(this);
+    }
+    updateSubscription();
+}
+
+void TrackIndicator::hideEvent(QHideEvent*) { updateSubscription(); }
+
+bool TrackIndicator::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == watchedWindow && event->type() == QEvent::WindowStateChange)
+        updateSubscription();
+    return QWidget::eventFilter(watched, event);
+}
+
+// Keeps the shared clock stopped whenever nothing animated can be seen:
+// stopped, hidden, or in a minimized window.
+void TrackIndicator::updateSubscription()
+{
+    bool want = running && isVisible() && !window()->isMinimized();
+    if (want == subscribed)
+        return;
+
+    subscribed = want;
+    if (want)
+        AnimationClock::instance()->subscribe();
+    else
+        AnimationClock::instance()->unsubscribe();
 }
 
-void TrackIndicator::start() { timer->start(100); }
-void TrackIndicator::stop()  { timer->stop(); }
+void TrackIndicator::advance()
+{
+    if (!subscribed)
+        return;
+
+    SpectrumAnalyzer::Bands target = spectrum->bands();
+
+    // Rise instantly, fall gradually
+    bool changed = false;
+    for (int i = 0; i < spectrum->bandCount(); ++i) {
+        int next = qMax<int>(target[i], levels[i] - 12);
+        next = qMax(next, 0);
+        if (next != levels[i]) {
+            levels[i] = uint8_t(next);
+            changed = true;
+        }
+    }
+
+    if (changed)
+        update();
+}
 
 void TrackIndicator::paintEvent(QPaintEvent*)
 {
     QPainter p(this);
     p.setRenderHint(QPainter::Antialiasing);
 
-    int barCount = 5;
+    int barCount = spectrum->bandCount();
     int w = width() / barCount;
     for (int i = 0; i < barCount; ++i) {
-        int h = QRandomGenerator::global()->bounded(height());
+        int h = qMax(1, levels[i] * height() / 255);
         p.fillRect(i * w, height() - h, w - 2, h, Qt::green);
     }
 }
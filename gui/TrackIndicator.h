@@ -1,17 +1,30 @@
 #pragma once
+#include <QPointer>
 #include <QWidget>
-#include <QTimer>
+
+#include "SpectrumAnalyzer.h"
 
 class TrackIndicator : public QWidget {
     Q_OBJECT
 public:
-    explicit TrackIndicator(QWidget* parent = nullptr);
+    explicit TrackIndicator(const SpectrumAnalyzer* spectrum, QWidget* parent = nullptr);
+    ~TrackIndicator() override;
     void start();
     void stop();
 
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
 
 private:
-    QTimer* timer;
+    void advance();
+    void updateSubscription();
+
+    const SpectrumAnalyzer* spectrum;
+    QPointer<QWidget> watchedWindow; // for minimize / restore
+    SpectrumAnalyzer::Bands levels{};
+    bool running = false;
+    bool subscribed = false;
 };
@@ -1,12 +1,25 @@
 #include <QApplication>
+#include <cstring>
 #include "MainWindow.h"
+#include "StartupReport.h"
 
 int run_gui(int argc, char* argv[])
 {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--startup-report") == 0)
+            StartupReport::enable();
+    }
+
     QApplication app(argc, argv);
+    app.setOrganizationName("Rensselaer");
+    app.setApplicationName("player");
+    StartupReport::mark("qapplication");
 
     MainWindow window;
+    StartupReport::mark("main window");
+
     window.show();
+    StartupReport::mark("show");
 
     return app.exec();
 }
@@ -2,13 +2,20 @@
 #include <string>
 
 int run_cli();
+int run_stats(int argc, char* argv[]);
 #ifdef CLI_ONLY
+int run_daemon(const std::string& socketPath);
 int run_gui(int argc, char* argv[])
 {
     std::cerr << "GUI not available in CLI build.\n";
     return 1;
 }
 #else
+int run_daemon(const std::string&)
+{
+    std::cerr << "Daemon not available in GUI build.\n";
+    return 1;
+}
 int run_gui(int argc, char* argv[]);
 #endif
 
@@ -24,7 +31,13 @@ int main(int argc, char* argv[])
     if (mode == "--cli") {
         return run_cli();
     }
-    else if (mode == "--gui") {
+    else if (mode == "--stats") {
+        return run_stats(argc - 2, argv + 2);
+    }
+    else if (mode == "--daemon") {
+        return run_daemon(argc > 2 ? argv[2] : "");
+    }
+    else if (mode == "--gui" || mode == "--startup-report") {
         return run_gui(argc, argv);
     }
     else {